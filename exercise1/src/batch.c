@@ -0,0 +1,222 @@
+#include <omp.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "batch.h"
+#include "libgol.h"
+#include "rw.h"
+
+#define ALIVE 0
+#define DEAD 255
+
+#define MAX_LINE 1024
+#define BATCH_FILE_NAME "snapshots/batch.csv"
+#define BOARD_FILE_NAME "board"
+
+/*
+* Fields of the summary of each board
+*/
+#define RESULT_ROWS 0
+#define RESULT_COLS 1
+#define RESULT_PERIOD 2
+#define RESULT_POPULATION 3
+#define RESULT_FIELDS 4
+
+/**
+ * Read the list of initial conditions, skipping empty lines and comments.
+ *
+ * @param list_file The name of the file.
+ * @param count The number of initial conditions read.
+ */
+char **read_batch_list(char *list_file, int *count) {
+    FILE *fp = fopen(list_file, "r");
+    int capacity = 64;
+    char **lines = (char **) malloc(capacity * sizeof(char *));
+    char line[MAX_LINE];
+
+    *count = 0;
+
+    if (!fp) {
+        printf("Error: Unable to open file %s\n", list_file);
+        return lines;
+    }
+
+    while (fgets(line, MAX_LINE, fp) != NULL) {
+        // Trim the line
+        char *start = line;
+        while (isspace((unsigned char) *start)) start++;
+        char *end = start + strlen(start);
+        while (end > start && isspace((unsigned char) end[-1])) end--;
+        *end = '\0';
+
+        if (*start == '\0' || *start == '#') continue;
+
+        if (*count == capacity) {
+            capacity *= 2;
+            lines = (char **) realloc(lines, capacity * sizeof(char *));
+        }
+        lines[*count] = strdup(start);
+        (*count)++;
+    }
+
+    fclose(fp);
+    return lines;
+}
+
+/**
+ * Given a seed, fill the grid with a random board (thread safe generator).
+ *
+ * @param grid The grid.
+ * @param rows The number of rows.
+ * @param cols The number of columns.
+ * @param seed The seed of the generator.
+ */
+void generate_random_board(int *grid, int rows, int cols, unsigned int seed) {
+    for (int i = 0; i < rows * cols; i++) {
+        grid[i] = rand_r(&seed) % 2 == 0 ? ALIVE : DEAD;
+    }
+}
+
+void run_batch(char *list_file, int evolution, int steps, int k, int c, int save_final, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    int count;
+    char **lines = read_batch_list(list_file, &count);
+
+    long long *results = (long long *) calloc((size_t) count * RESULT_FIELDS, sizeof(long long));
+    double *times = (double *) calloc(count, sizeof(double));
+
+    // Work queue: the index of the next board is a counter in a window of rank 0
+    int *counter;
+    MPI_Win win;
+    MPI_Win_allocate(rank == 0 ? sizeof(int) : 0, sizeof(int), MPI_INFO_NULL, comm, &counter, &win);
+    if (rank == 0) {
+        *counter = 0;
+    }
+    MPI_Barrier(comm);
+    MPI_Win_lock_all(0, win);
+
+    double start = MPI_Wtime();
+
+    // Without MPI_THREAD_SERIALIZED only the main thread may call MPI: one thread per process
+    int provided;
+    MPI_Query_thread(&provided);
+    int threads = (provided < MPI_THREAD_SERIALIZED) ? 1 : omp_get_max_threads();
+
+    // Each board is evolved by a single thread (no nested parallel regions),
+    // the nesting of the caller is restored at the end
+    int max_levels = omp_get_max_active_levels();
+    omp_set_max_active_levels(1);
+
+    #pragma omp parallel num_threads(threads)
+    {
+        gol_t *gol;
+
+        // The MPI calls of the threads are serialized
+        #pragma omp critical (mpi)
+        gol = gol_create(MPI_COMM_SELF, evolution);
+        gol_set_cycle_detection(gol, c);
+
+        int *grid = NULL;
+        size_t grid_capacity = 0;
+
+        while (1) {
+            int board;
+            int one = 1;
+
+            #pragma omp critical (mpi)
+            {
+                MPI_Fetch_and_op(&one, &board, MPI_INT, 0, 0, MPI_SUM, win);
+                MPI_Win_flush(0, win);
+            }
+
+            if (board >= count) break;
+
+            double board_start = omp_get_wtime();
+
+            // A line starting with a digit is a seed, otherwise a file name
+            if (isdigit((unsigned char) lines[board][0])) {
+                if ((size_t) k * k > grid_capacity) {
+                    grid_capacity = (size_t) k * k;
+                    grid = (int *) realloc(grid, grid_capacity * sizeof(int));
+                }
+                generate_random_board(grid, k, k, (unsigned int) strtoul(lines[board], NULL, 10));
+                gol_load_grid(gol, grid, k, k);
+            } else {
+                gol_load(gol, lines[board]);
+            }
+
+            gol_step(gol, steps);
+
+            long long *result = &results[(size_t) board * RESULT_FIELDS];
+            result[RESULT_ROWS] = gol_get_rows(gol);
+            result[RESULT_COLS] = gol_get_cols(gol);
+            result[RESULT_PERIOD] = gol_get_period(gol);
+            result[RESULT_POPULATION] = gol_get_population(gol);
+
+            // Save the final state of the board
+            if (save_final) {
+                size_t board_size = (size_t) gol_get_rows(gol) * gol_get_cols(gol);
+                if (board_size > grid_capacity) {
+                    grid_capacity = board_size;
+                    grid = (int *) realloc(grid, grid_capacity * sizeof(int));
+                }
+                gol_get_grid(gol, grid);
+                save_named_image_utils(grid, gol_get_rows(gol), gol_get_cols(gol), BOARD_FILE_NAME, board);
+            }
+
+            times[board] = omp_get_wtime() - board_start;
+        }
+
+        gol_destroy(gol);
+        free(grid);
+    }
+
+    omp_set_max_active_levels(max_levels);
+
+    double elapsed = MPI_Wtime() - start;
+
+    MPI_Win_unlock_all(win);
+    MPI_Win_free(&win);
+
+    // Each board has been evolved by a single process, so the summaries are summed on rank 0
+    if (rank == 0) {
+        MPI_Reduce(MPI_IN_PLACE, results, count * RESULT_FIELDS, MPI_LONG_LONG, MPI_SUM, 0, comm);
+        MPI_Reduce(MPI_IN_PLACE, times, count, MPI_DOUBLE, MPI_SUM, 0, comm);
+        MPI_Reduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    } else {
+        MPI_Reduce(results, NULL, count * RESULT_FIELDS, MPI_LONG_LONG, MPI_SUM, 0, comm);
+        MPI_Reduce(times, NULL, count, MPI_DOUBLE, MPI_SUM, 0, comm);
+        MPI_Reduce(&elapsed, NULL, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    }
+
+    if (rank == 0) {
+        create_folder();
+        FILE *fp = fopen(BATCH_FILE_NAME, "w");
+        if (fp) {
+            fprintf(fp, "board, source, rows, cols, steps, period, population, time\n");
+            for (int board = 0; board < count; board++) {
+                long long *result = &results[(size_t) board * RESULT_FIELDS];
+                fprintf(fp, "%d, %s, %lld, %lld, %d, %lld, %lld, %lf\n", board, lines[board],
+                    result[RESULT_ROWS], result[RESULT_COLS], steps, result[RESULT_PERIOD],
+                    result[RESULT_POPULATION], times[board]);
+            }
+            fclose(fp);
+        } else {
+            printf("Error: Unable to open file %s\n", BATCH_FILE_NAME);
+        }
+
+        printf("Batch: %d boards evolved in %lf s\n", count, elapsed);
+    }
+
+    for (int board = 0; board < count; board++) {
+        free(lines[board]);
+    }
+    free(lines);
+    free(results);
+    free(times);
+}
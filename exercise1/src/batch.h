@@ -0,0 +1,33 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <mpi.h>
+
+/**
+ * Given a list of initial conditions, evolve each board for the given number of
+ * steps. Whole boards are distributed among the processes and their OpenMP threads
+ * with a dynamic work queue: a counter on rank 0 (MPI window) is incremented with
+ * MPI_Fetch_and_op to get the next board. Each thread evolves its boards with its
+ * own engine context on MPI_COMM_SELF, so the buffers are reused among the boards.
+ *
+ * Each line of the list is either the name of a PGM file (without extension) or
+ * a seed (a number) for a random board of k x k cells. Empty lines and lines
+ * starting with # are ignored.
+ *
+ * Rank 0 writes a summary for each board in the snapshots folder (batch.csv) and,
+ * if save_final is set, the final state of each board is saved as board0000<id>.pgm
+ *
+ * With less than MPI_THREAD_SERIALIZED (MPI_Query_thread) a single thread per process
+ * is used. The maximum number of active levels of the caller is restored at the end.
+ *
+ * @param list_file: name of the file with the list of initial conditions
+ * @param evolution: evolution type (ORDERED, STATIC, BLACK_WHITE_STATIC, SPARSE)
+ * @param steps: number of evolutions of each board
+ * @param k: number of rows and columns of the random boards
+ * @param c: number of past states remembered by the cycle detection (0: no detection)
+ * @param save_final: 1 to save the final state of each board
+ * @param comm: communicator of the processes that share the work
+ */
+void run_batch(char *list_file, int evolution, int steps, int k, int c, int save_final, MPI_Comm comm);
+
+#endif
@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "cycle.h"
+
+#define ALIVE 0
+#define DEAD 255
+
+unsigned long long mix_hash(unsigned long long x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+unsigned long long mix_hash_second(unsigned long long x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+void init_cycle(cycle_t *cycle, int history) {
+    cycle->history = history;
+    cycle->count = 0;
+    cycle->period = 0;
+    cycle->hashes = (board_hash_t *) malloc(history * sizeof(board_hash_t));
+    cycle->steps = (int *) malloc(history * sizeof(int));
+}
+
+void free_cycle(cycle_t *cycle) {
+    free(cycle->hashes);
+    free(cycle->steps);
+}
+
+board_hash_t hash_local_grid(int *local_grid_wg, int local_rows, int local_cols, int row_start) {
+    int local_cols_wg = local_cols + 2;
+    unsigned long long first = 0, second = 0;
+
+    #pragma omp parallel for schedule(static) reduction(+:first, second)
+    for (int i = 0; i < local_rows; i++) {
+        int *row = &local_grid_wg[(i + 1) * local_cols_wg + 1];
+        unsigned long long row_hash = mix_hash((unsigned long long) (row_start + i) + 1);
+        unsigned long long row_second = mix_hash_second(~(unsigned long long) (row_start + i));
+
+        // The cells are packed 64 at a time in a word before being mixed
+        for (int j = 0; j < local_cols; j += 64) {
+            unsigned long long word = 0;
+            int end = (j + 64 < local_cols) ? j + 64 : local_cols;
+            for (int l = j; l < end; l++) {
+                word = (word << 1) | (row[l] == ALIVE);
+            }
+            row_hash = mix_hash(row_hash ^ word);
+            row_second = mix_hash_second(row_second + word);
+        }
+
+        first += row_hash;
+        second += row_second;
+    }
+
+    board_hash_t hash = { first, second };
+    return hash;
+}
+
+board_hash_t hash_grid(int *local_grid_wg, int local_rows, int local_cols, int row_start, MPI_Comm comm) {
+    board_hash_t local_hash = hash_local_grid(local_grid_wg, local_rows, local_cols, row_start);
+    unsigned long long local[2] = { local_hash.first, local_hash.second }, global[2];
+
+    MPI_Allreduce(local, global, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+
+    board_hash_t hash = { global[0], global[1] };
+    return hash;
+}
+
+int detect_cycle(cycle_t *cycle, board_hash_t hash, int step) {
+    int period = 0;
+    int stored = (cycle->count < cycle->history) ? cycle->count : cycle->history;
+
+    // Look for the most recent state with the same hashes
+    for (int i = 1; i <= stored && period == 0; i++) {
+        int id = (cycle->count - i) % cycle->history;
+        if (cycle->hashes[id].first == hash.first && cycle->hashes[id].second == hash.second) {
+            period = step - cycle->steps[id];
+        }
+    }
+
+    int id = cycle->count % cycle->history;
+    cycle->hashes[id] = hash;
+    cycle->steps[id] = step;
+    cycle->count++;
+    cycle->period = period;
+
+    return period;
+}
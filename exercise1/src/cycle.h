@@ -0,0 +1,97 @@
+#ifndef CYCLE_H
+#define CYCLE_H
+
+#include <mpi.h>
+
+/*
+* first, second: two independent 64 bit hashes of a state (different mixing
+* functions and seeds), a period is accepted only when both match
+*/
+typedef struct {
+    unsigned long long first;
+    unsigned long long second;
+} board_hash_t;
+
+/*
+* history: number of past states (K) that are remembered
+* count: number of states pushed so far
+* period: period of the cycle once it has been found (0 until then)
+* hashes: ring buffer with the (pairs of) hashes of the last K states
+* steps: ring buffer with the steps of the last K states
+*/
+typedef struct {
+    int history;
+    int count;
+    int period;
+    board_hash_t *hashes;
+    int *steps;
+} cycle_t;
+
+/**
+ * Mix the bits of a 64 bit word (finalizer of splitmix64).
+ *
+ * @param x: the word to mix
+ */
+unsigned long long mix_hash(unsigned long long x);
+
+/**
+ * Mix the bits of a 64 bit word with a function independent of mix_hash
+ * (finalizer of MurmurHash3), for the second hash of a state.
+ *
+ * @param x: the word to mix
+ */
+unsigned long long mix_hash_second(unsigned long long x);
+
+/**
+ * Allocate the ring buffers that remember the hashes of the last states.
+ *
+ * @param cycle: cycle detector to initialize
+ * @param history: number of past states (K) that are remembered
+ */
+void init_cycle(cycle_t *cycle, int history);
+
+/**
+ * Free the memory allocated by init_cycle.
+ *
+ * @param cycle: cycle detector to free
+ */
+void free_cycle(cycle_t *cycle);
+
+/**
+ * Given the local grid with ghost rows and columns, compute the two hashes of its
+ * rows. Each row is hashed together with its global index and the row hashes are
+ * summed, so the hashes of the different processes can be combined with a sum as well.
+ *
+ * @param local_grid_wg: local grid with ghost rows and columns
+ * @param local_rows: number of rows of the local grid
+ * @param local_cols: number of columns of the local grid
+ * @param row_start: global index of the first row of the local grid
+ */
+board_hash_t hash_local_grid(int *local_grid_wg, int local_rows, int local_cols, int row_start);
+
+/**
+ * Compute the two hashes of the full grid combining the local hashes of all the
+ * processes of the communicator with MPI_Allreduce, so every process knows it.
+ *
+ * @param local_grid_wg: local grid with ghost rows and columns
+ * @param local_rows: number of rows of the local grid
+ * @param local_cols: number of columns of the local grid
+ * @param row_start: global index of the first row of the local grid
+ * @param comm: communicator of the processes that own the grid
+ */
+board_hash_t hash_grid(int *local_grid_wg, int local_rows, int local_cols, int row_start, MPI_Comm comm);
+
+/**
+ * Given the hashes of the state reached at step, look for them among the last K
+ * states and remember them. If the state is repeated (both hashes match, so a
+ * false cycle needs a collision of two independent 64 bit hashes at once) returns
+ * the period of the cycle (1 for a still life) and stores it in the detector,
+ * otherwise returns 0.
+ *
+ * @param cycle: cycle detector
+ * @param hash: hashes of the full grid
+ * @param step: the step of the simulation
+ */
+int detect_cycle(cycle_t *cycle, board_hash_t hash, int step);
+
+#endif
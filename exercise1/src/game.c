@@ -80,13 +80,13 @@ MPI_Send(&local_grid_wg[(local_rows_wg - 2) * local_cols_wg], local_cols_wg, MPI
 MPI_Recv(&local_grid_wg[0], local_cols_wg, MPI_INT, upper_rank, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 
 */
-void exchange_ghost_rows(int *local_grid_wg, int local_rows_wg, int local_cols_wg, int upper_rank, int lower_rank) {
+void exchange_ghost_rows(int *local_grid_wg, int local_rows_wg, int local_cols_wg, int upper_rank, int lower_rank, MPI_Comm comm) {
     MPI_Request request1, request2;
-    MPI_Isend(&local_grid_wg[local_cols_wg], local_cols_wg, MPI_INT, upper_rank, 0, MPI_COMM_WORLD, &request1);
-    MPI_Irecv(&local_grid_wg[(local_rows_wg - 1) * local_cols_wg], local_cols_wg, MPI_INT, lower_rank, 0, MPI_COMM_WORLD, &request1);
+    MPI_Isend(&local_grid_wg[local_cols_wg], local_cols_wg, MPI_INT, upper_rank, 0, comm, &request1);
+    MPI_Irecv(&local_grid_wg[(local_rows_wg - 1) * local_cols_wg], local_cols_wg, MPI_INT, lower_rank, 0, comm, &request1);
     
-    MPI_Isend(&local_grid_wg[(local_rows_wg - 2) * local_cols_wg], local_cols_wg, MPI_INT, lower_rank, 1, MPI_COMM_WORLD, &request2);
-    MPI_Irecv(&local_grid_wg[0], local_cols_wg, MPI_INT, upper_rank, 1, MPI_COMM_WORLD, &request2);
+    MPI_Isend(&local_grid_wg[(local_rows_wg - 2) * local_cols_wg], local_cols_wg, MPI_INT, lower_rank, 1, comm, &request2);
+    MPI_Irecv(&local_grid_wg[0], local_cols_wg, MPI_INT, upper_rank, 1, comm, &request2);
     MPI_Wait(&request1, MPI_STATUS_IGNORE);
     MPI_Wait(&request2, MPI_STATUS_IGNORE);
 }
@@ -105,3 +105,26 @@ void compute_ghost_rows(int *grid, int rows, int cols, int rows_wg, int cols_wg)
     }
 }
 
+void ordered_evolution(int *grid_wg, int rows, int cols, int rows_wg, int cols_wg) {
+    // Compute ghost rows and columns
+    compute_ghost_rows(grid_wg, rows, cols, rows_wg, cols_wg);
+    compute_ghost_cols(grid_wg, rows_wg, cols_wg);
+
+    for(int i = 1; i < rows_wg - 1; i++) {
+        for(int j = 1; j < cols_wg - 1; j++) {
+            int count = count_alive_neighbors(grid_wg, i, j, cols_wg);
+            if (count < 2 || count > 3) {
+                grid_wg[i * cols_wg + j] = DEAD;
+                compute_ghost_rows(grid_wg, rows, cols, rows_wg, cols_wg);
+                compute_ghost_cols(grid_wg, rows_wg, cols_wg);
+            } else if (count == 3) {
+                grid_wg[i * cols_wg + j] = ALIVE;
+                compute_ghost_rows(grid_wg, rows, cols, rows_wg, cols_wg);
+                compute_ghost_cols(grid_wg, rows_wg, cols_wg);
+            } else {
+                grid_wg[i * cols_wg + j] = grid_wg[i * cols_wg + j];
+            }
+        }
+    }
+}
+
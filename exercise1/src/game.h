@@ -1,6 +1,8 @@
 #ifndef GAME
 #define GAME
 
+#include <mpi.h>
+
 /**
  * Given a the grid and the position of a cell, returns the number of alive neighbors.
  *
@@ -57,8 +59,9 @@ void white_static_evolution(int *grid, int *grid_ns, int rows, int cols);
  * @param local_cols_wg: number of columns of the local grid with ghost rows
  * @param upper_rank: rank of the upper process
  * @param lower_rank: rank of the lower process
+ * @param comm: communicator of the processes that own the grid
  */
-void exchange_ghost_rows(int *local_grid_wg, int local_rows_wg, int local_cols_wg, int upper_rank, int lower_rank);
+void exchange_ghost_rows(int *local_grid_wg, int local_rows_wg, int local_cols_wg, int upper_rank, int lower_rank, MPI_Comm comm);
 
 /**
  * Copy the last column of the local grid to the first column of the ghost columns
@@ -84,4 +87,21 @@ void compute_ghost_cols(int *local_grid_wg, int local_rows_wg, int local_cols_wg
  */
 void compute_ghost_rows(int *grid, int rows, int cols, int rows_wg, int cols_wg);
 
+/**
+ * Given the grid with ghost rows and columns, compute the next state of the game
+ * in place, cell after cell (serial by definition):
+ * - if the cell has less than 2 or more than 3 alive neighbors, the cell dies
+ * - if the cell has 3 alive neighbors, the cell survives or becomes alive
+ * - if the cell has 2 alive neighbors, the cell state remains the same
+ * After each change the ghost rows and columns are computed again, so the next
+ * cells already see the new state.
+ *
+ * @param grid_wg: grid with ghost rows and columns
+ * @param rows: number of rows of the grid
+ * @param cols: number of columns of the grid
+ * @param rows_wg: number of rows of the grid with ghost rows
+ * @param cols_wg: number of columns of the grid with ghost rows
+ */
+void ordered_evolution(int *grid_wg, int rows, int cols, int rows_wg, int cols_wg);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,590 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "cycle.h"
+#include "game.h"
+#include "libgol.h"
+#include "rw.h"
+#include "sparse.h"
+#include "stats.h"
+
+#define ALIVE 0
+#define DEAD 255
+
+#define POOL_ALIGNMENT 64
+
+/*
+* comm, rank, size: communicator of the processes that own the board
+* evolution: evolution type (ORDERED, STATIC, BLACK_WHITE_STATIC, SPARSE)
+* a, c, total: analysis frequency, cycle detection history and progress total
+* active: 1 if the process evolves the board (only rank 0 for ORDERED and SPARSE)
+* rows, cols: dimension of the full grid
+* local_rows, local_cols: dimension of the local grid (all the grid for ORDERED)
+* local_rows_wg, local_cols_wg: dimension of the local grid with ghost rows and columns
+* offset: number of extra rows of the last process
+* row_start: global index of the first row of the local grid
+* upper_rank, lower_rank: ranks of the processes that own the rows above and below
+* step: number of evolutions performed since the board was loaded
+* pool, pool_capacity, pool_used: preallocated memory from which the buffers are carved
+* local_grid_wg, local_grid_ns: local grid and next state with ghost rows and columns
+* local_grid: staging buffer of the local grid (scatter and gather)
+* full_grid: staging buffer of the full grid (only rank 0)
+* universe: the unbounded universe (only SPARSE)
+* local_stats, global_stats: in-situ statistics
+* cycle: cycle detector
+*/
+struct gol {
+    MPI_Comm comm;
+    int rank;
+    int size;
+    int evolution;
+    int a;
+    int c;
+    int total;
+    int active;
+    int loaded;
+    int rows;
+    int cols;
+    int local_rows;
+    int local_cols;
+    int local_rows_wg;
+    int local_cols_wg;
+    int offset;
+    int row_start;
+    int upper_rank;
+    int lower_rank;
+    int step;
+    char *pool;
+    size_t pool_capacity;
+    size_t pool_used;
+    int *local_grid_wg;
+    int *local_grid_ns;
+    int *local_grid;
+    int *full_grid;
+    universe_t universe;
+    stats_t local_stats;
+    stats_t global_stats;
+    cycle_t cycle;
+};
+
+/**
+ * Given a number of bytes, returns it rounded up to the alignment of the pool.
+ *
+ * @param bytes The number of bytes.
+ */
+size_t pool_size(size_t bytes) {
+    return (bytes + POOL_ALIGNMENT - 1) / POOL_ALIGNMENT * POOL_ALIGNMENT;
+}
+
+/**
+ * Make sure that the pool can contain the given number of bytes (the memory is
+ * allocated again only if the pool is too small) and mark it as empty.
+ *
+ * @param gol The context.
+ * @param bytes The number of bytes (sum of the sizes returned by pool_size).
+ */
+void pool_reserve(gol_t *gol, size_t bytes) {
+    if (bytes > gol->pool_capacity) {
+        free(gol->pool);
+        gol->pool = (char *) aligned_alloc(POOL_ALIGNMENT, bytes);
+        gol->pool_capacity = bytes;
+    }
+    gol->pool_used = 0;
+}
+
+/**
+ * Carve a buffer from the pool (NULL if bytes is 0).
+ *
+ * @param gol The context.
+ * @param bytes The number of bytes of the buffer.
+ */
+void *pool_alloc(gol_t *gol, size_t bytes) {
+    if (bytes == 0) {
+        return NULL;
+    }
+
+    void *ptr = gol->pool + gol->pool_used;
+    gol->pool_used += pool_size(bytes);
+    return ptr;
+}
+
+/**
+ * Returns 1 if the evolution distributes the rows of the grid among the processes.
+ *
+ * @param gol The context.
+ */
+int is_distributed(gol_t *gol) {
+    return gol->evolution == STATIC || gol->evolution == BLACK_WHITE_STATIC;
+}
+
+gol_t *gol_create(MPI_Comm comm, int evolution) {
+    gol_t *gol = (gol_t *) calloc(1, sizeof(gol_t));
+
+    gol->comm = comm;
+    MPI_Comm_rank(comm, &gol->rank);
+    MPI_Comm_size(comm, &gol->size);
+    gol->evolution = evolution;
+    gol->active = is_distributed(gol) || gol->rank == 0;
+
+    // Computing the ranks of the processes that have the local grid below
+    // or above to the current process
+    gol->upper_rank = (gol->rank == 0) ? gol->size - 1 : gol->rank - 1;
+    gol->lower_rank = (gol->rank == gol->size - 1) ? 0 : gol->rank + 1;
+
+    if (gol->evolution == SPARSE && gol->active) {
+        init_universe(&gol->universe);
+    }
+
+    return gol;
+}
+
+void gol_set_analysis(gol_t *gol, int a) {
+    gol->a = a;
+}
+
+void gol_set_cycle_detection(gol_t *gol, int c) {
+    gol->c = c;
+}
+
+void gol_set_progress(gol_t *gol, int total) {
+    gol->total = total;
+}
+
+/**
+ * Free the statistics and the cycle detector of the board loaded in the context.
+ *
+ * @param gol The context.
+ */
+void unload_board(gol_t *gol) {
+    if (!gol->loaded || !gol->active) {
+        gol->loaded = 0;
+        return;
+    }
+
+    if (gol->a > 0) {
+        free_stats(&gol->local_stats);
+        free_stats(&gol->global_stats);
+    }
+    if (gol->c > 0) {
+        free_cycle(&gol->cycle);
+    }
+    if (gol->evolution == SPARSE) {
+        free_universe(&gol->universe);
+        init_universe(&gol->universe);
+    }
+
+    gol->loaded = 0;
+}
+
+/**
+ * Given the dimension of the full grid, compute the dimension of the local grid
+ * and carve all the buffers from the pool.
+ *
+ * @param gol The context.
+ * @param rows The number of rows of the full grid.
+ * @param cols The number of columns of the full grid.
+ */
+void setup_board(gol_t *gol, int rows, int cols) {
+    gol->rows = rows;
+    gol->cols = cols;
+
+    if (is_distributed(gol)) {
+        // If the number of rows is not divisible by the number of processes,
+        // the last process will work also on the remaining rows
+        gol->local_rows = rows / gol->size;
+        gol->offset = rows % gol->size;
+        if (gol->rank == gol->size - 1) {
+            gol->local_rows += gol->offset;
+        }
+        gol->row_start = gol->rank * (rows / gol->size);
+    } else {
+        gol->local_rows = rows;
+        gol->offset = 0;
+        gol->row_start = 0;
+    }
+    gol->local_cols = cols;
+    gol->local_rows_wg = gol->local_rows + 2;
+    gol->local_cols_wg = gol->local_cols + 2;
+
+    size_t local_size = (size_t) gol->local_rows * gol->local_cols * sizeof(int);
+    size_t local_size_wg = (size_t) gol->local_rows_wg * gol->local_cols_wg * sizeof(int);
+    size_t full_size = (size_t) rows * cols * sizeof(int);
+
+    size_t grid_wg_bytes = (gol->active && gol->evolution != SPARSE) ? local_size_wg : 0;
+    size_t grid_ns_bytes = is_distributed(gol) ? local_size_wg : 0;
+    size_t local_grid_bytes = is_distributed(gol) ? local_size : 0;
+    size_t full_grid_bytes = (gol->rank == 0) ? full_size : 0;
+
+    pool_reserve(gol, pool_size(grid_wg_bytes) + pool_size(grid_ns_bytes) + pool_size(local_grid_bytes) + pool_size(full_grid_bytes));
+
+    gol->local_grid_wg = (int *) pool_alloc(gol, grid_wg_bytes);
+    gol->local_grid_ns = (int *) pool_alloc(gol, grid_ns_bytes);
+    gol->local_grid = (int *) pool_alloc(gol, local_grid_bytes);
+    gol->full_grid = (int *) pool_alloc(gol, full_grid_bytes);
+}
+
+/**
+ * Returns the hashes of the board (the same on all the processes that evolve it).
+ *
+ * @param gol The context.
+ */
+board_hash_t hash_board(gol_t *gol) {
+    if (gol->evolution == SPARSE) {
+        return hash_universe(&gol->universe);
+    }
+    if (is_distributed(gol) && gol->size > 1) {
+        return hash_grid(gol->local_grid_wg, gol->local_rows, gol->local_cols, gol->row_start, gol->comm);
+    }
+    return hash_local_grid(gol->local_grid_wg, gol->local_rows, gol->local_cols, gol->row_start);
+}
+
+/**
+ * Compute the in-situ statistics of the board and append them to the time series.
+ *
+ * @param gol The context.
+ */
+void analyse_board(gol_t *gol) {
+    if (gol->evolution == SPARSE) {
+        compute_universe_stats(&gol->universe, &gol->local_stats);
+        save_stats_utils(&gol->local_stats, 0, 0, gol->step);
+    } else if (is_distributed(gol) && gol->size > 1) {
+        compute_stats(&gol->local_stats, &gol->global_stats, gol->local_grid_wg, gol->local_rows, gol->local_cols, gol->row_start, gol->rows, gol->cols, gol->step, gol->comm);
+    } else {
+        compute_local_stats(&gol->local_stats, gol->local_grid_wg, gol->local_rows, gol->local_cols, gol->row_start, gol->rows, gol->cols);
+        save_stats_utils(&gol->local_stats, gol->rows, gol->cols, gol->step);
+    }
+}
+
+/**
+ * Given the full grid in the staging buffer of rank 0, distribute it among the
+ * processes (or place it in the universe) and initialize the statistics and the
+ * cycle detection.
+ *
+ * @param gol The context.
+ */
+void distribute_board(gol_t *gol) {
+    int rows = gol->rows;
+    int cols = gol->cols;
+    int local_cols_wg = gol->local_cols_wg;
+
+    if (is_distributed(gol)) {
+        // Process 0 sends the local grid to the other processes and it keeps
+        // the local grid for itself
+        int local_size = (rows / gol->size) * cols;
+        if (gol->rank == 0) {
+            for (int i = 0; i < gol->local_rows * cols; i++) {
+                gol->local_grid[i] = gol->full_grid[i];
+            }
+
+            for (int i = 1; i < gol->size; i++) {
+                if (i < gol->size - 1) {
+                    MPI_Send(&gol->full_grid[i * local_size], local_size, MPI_INT, i, 0, gol->comm);
+                } else {
+                    MPI_Send(&gol->full_grid[i * local_size], local_size + gol->offset * cols, MPI_INT, i, 0, gol->comm);
+                }
+            }
+        } else {
+            MPI_Recv(&gol->local_grid[0], gol->local_rows * cols, MPI_INT, 0, 0, gol->comm, MPI_STATUS_IGNORE);
+        }
+    }
+
+    if (gol->active && gol->evolution == SPARSE) {
+        // The chunks are allocated only where there are alive cells
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                if (gol->full_grid[i * cols + j] == ALIVE) {
+                    set_cell(&gol->universe, i, j, 1);
+                }
+            }
+        }
+    } else if (gol->active) {
+        // Copy the local grid to the local grid with ghost rows and columns
+        int *local_grid = is_distributed(gol) ? gol->local_grid : gol->full_grid;
+        for (int i = 0; i < gol->local_rows; i++) {
+            for (int j = 0; j < gol->local_cols; j++) {
+                gol->local_grid_wg[(i + 1) * local_cols_wg + (j + 1)] = local_grid[i * gol->local_cols + j];
+            }
+        }
+    }
+
+    gol->step = 0;
+    gol->loaded = 1;
+
+    if (gol->active && gol->a > 0) {
+        // The unbounded universe has no heatmap
+        int stats_rows = (gol->evolution == SPARSE) ? 0 : rows;
+        int stats_cols = (gol->evolution == SPARSE) ? 0 : cols;
+        init_stats(&gol->local_stats, stats_rows, stats_cols);
+        init_stats(&gol->global_stats, stats_rows, stats_cols);
+        if (gol->rank == 0) {
+            create_stats_file();
+        }
+    }
+
+    if (gol->active && gol->c > 0) {
+        init_cycle(&gol->cycle, gol->c);
+        detect_cycle(&gol->cycle, hash_board(gol), 0);
+    }
+}
+
+void gol_load(gol_t *gol, char *file_name) {
+    int dims[2];
+
+    unload_board(gol);
+
+    // Process 0 reads the number of rows and columns of the image and
+    // sends them to the other processes
+    if (gol->rank == 0) {
+        dims[0] = read_rows(file_name);
+        dims[1] = read_cols(file_name);
+    }
+    if (gol->size > 1) {
+        MPI_Bcast(dims, 2, MPI_INT, 0, gol->comm);
+    }
+
+    setup_board(gol, dims[0], dims[1]);
+
+    if (gol->rank == 0) {
+        read_image_utils(gol->full_grid, file_name, gol->rows, gol->cols);
+    }
+
+    distribute_board(gol);
+}
+
+void gol_load_grid(gol_t *gol, int *grid, int rows, int cols) {
+    unload_board(gol);
+
+    setup_board(gol, rows, cols);
+
+    if (gol->rank == 0) {
+        memcpy(gol->full_grid, grid, (size_t) rows * cols * sizeof(int));
+    }
+
+    distribute_board(gol);
+}
+
+/**
+ * Exchange (or compute, if the grid is owned by a single process) the ghost rows
+ * and compute the ghost columns of the local grid.
+ *
+ * @param gol The context.
+ */
+void update_ghosts(gol_t *gol) {
+    if (gol->size > 1) {
+        exchange_ghost_rows(gol->local_grid_wg, gol->local_rows_wg, gol->local_cols_wg, gol->upper_rank, gol->lower_rank, gol->comm);
+    } else {
+        compute_ghost_rows(gol->local_grid_wg, gol->local_rows, gol->local_cols, gol->local_rows_wg, gol->local_cols_wg);
+    }
+    compute_ghost_cols(gol->local_grid_wg, gol->local_rows_wg, gol->local_cols_wg);
+}
+
+/**
+ * Swap the local grid and the next state (instead of copying the next state).
+ *
+ * @param gol The context.
+ */
+void swap_grids(gol_t *gol) {
+    int *temp = gol->local_grid_wg;
+    gol->local_grid_wg = gol->local_grid_ns;
+    gol->local_grid_ns = temp;
+}
+
+/**
+ * Perform one evolution of the board.
+ *
+ * @param gol The context.
+ */
+void evolve_board(gol_t *gol) {
+    if (gol->evolution == STATIC) {
+        update_ghosts(gol);
+        static_evolution(gol->local_grid_wg, gol->local_grid_ns, gol->local_rows_wg, gol->local_cols_wg);
+        swap_grids(gol);
+    } else if (gol->evolution == BLACK_WHITE_STATIC) {
+        update_ghosts(gol);
+        black_static_evolution(gol->local_grid_wg, gol->local_grid_ns, gol->local_rows_wg, gol->local_cols_wg);
+        swap_grids(gol);
+
+        update_ghosts(gol);
+        white_static_evolution(gol->local_grid_wg, gol->local_grid_ns, gol->local_rows_wg, gol->local_cols_wg);
+        swap_grids(gol);
+    } else if (gol->evolution == ORDERED) {
+        ordered_evolution(gol->local_grid_wg, gol->rows, gol->cols, gol->local_rows_wg, gol->local_cols_wg);
+    } else if (gol->evolution == SPARSE) {
+        sparse_evolution(&gol->universe);
+    }
+}
+
+void gol_step(gol_t *gol, int steps) {
+    int target = gol->step + steps;
+
+    if (!gol->active) {
+        gol->step = target;
+        return;
+    }
+
+    while (gol->step < target) {
+        // The state repeats with the period found: only the remaining steps
+        // modulo the period are performed
+        if (gol->c > 0 && gol->cycle.period > 0) {
+            // The statistics of the analysis steps left are still written: the
+            // state of the step t is (t - step) modulo the period evolutions away
+            while (gol->a > 0 && (gol->step / gol->a + 1) * gol->a <= target) {
+                int next = (gol->step / gol->a + 1) * gol->a;
+                int skip = (next - gol->step) % gol->cycle.period;
+                for (int i = 0; i < skip; i++) {
+                    evolve_board(gol);
+                }
+                gol->step = next;
+                analyse_board(gol);
+            }
+
+            int remaining = (target - gol->step) % gol->cycle.period;
+            for (int i = 0; i < remaining; i++) {
+                evolve_board(gol);
+            }
+            gol->step = target;
+            break;
+        }
+
+        if (gol->rank == 0 && gol->total > 0) {
+            printf("Step %d/%d\n", gol->step + 1, gol->total);
+        }
+
+        evolve_board(gol);
+        gol->step++;
+
+        // Look for a cycle until one is found
+        if (gol->c > 0 && detect_cycle(&gol->cycle, hash_board(gol), gol->step) > 0 && gol->rank == 0 && gol->total > 0) {
+            printf("Cycle of period %d found at step %d: the remaining steps are evolved modulo the period\n", gol->cycle.period, gol->step);
+        }
+
+        // Compute the statistics based on the analysis frequency (a)
+        if (gol->a > 0 && gol->step % gol->a == 0) {
+            analyse_board(gol);
+        }
+    }
+}
+
+void gol_snapshot(gol_t *gol, int step) {
+    if (!gol->active) {
+        return;
+    }
+
+    if (is_distributed(gol)) {
+        save_image(gol->local_grid_wg, gol->local_grid, gol->full_grid, gol->local_rows, gol->local_cols, gol->rows, gol->cols, gol->rank, gol->size, gol->offset, step, gol->comm);
+    } else if (gol->evolution == ORDERED) {
+        int id = 0;
+        for (int i = 1; i <= gol->rows; i++) {
+            for (int j = 1; j <= gol->cols; j++) {
+                gol->full_grid[id] = gol->local_grid_wg[i * gol->local_cols_wg + j];
+                id++;
+            }
+        }
+        save_image_utils(gol->full_grid, gol->rows, gol->cols, step);
+    } else if (gol->evolution == SPARSE) {
+        save_universe_utils(&gol->universe, step);
+    }
+}
+
+int gol_get_step(gol_t *gol) {
+    return gol->step;
+}
+
+int gol_get_period(gol_t *gol) {
+    return (gol->active && gol->c > 0 && gol->loaded) ? gol->cycle.period : 0;
+}
+
+int gol_get_rows(gol_t *gol) {
+    return gol->rows;
+}
+
+int gol_get_cols(gol_t *gol) {
+    return gol->cols;
+}
+
+long long gol_get_population(gol_t *gol) {
+    long long population = 0;
+
+    if (!gol->active) {
+        return 0;
+    }
+
+    if (gol->evolution == SPARSE) {
+        return gol->universe.population;
+    }
+
+    int local_cols_wg = gol->local_cols_wg;
+    #pragma omp parallel for schedule(static) reduction(+:population)
+    for (int i = 1; i <= gol->local_rows; i++) {
+        for (int j = 1; j <= gol->local_cols; j++) {
+            population += (gol->local_grid_wg[i * local_cols_wg + j] == ALIVE);
+        }
+    }
+
+    if (is_distributed(gol) && gol->size > 1) {
+        MPI_Allreduce(MPI_IN_PLACE, &population, 1, MPI_LONG_LONG, MPI_SUM, gol->comm);
+    }
+
+    return population;
+}
+
+void gol_get_grid(gol_t *gol, int *grid) {
+    int rows = gol->rows;
+    int cols = gol->cols;
+
+    if (!gol->active) {
+        return;
+    }
+
+    if (gol->evolution == SPARSE) {
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                chunk_t *chunk = get_chunk(&gol->universe, i / CHUNK_SIZE, j / CHUNK_SIZE);
+                int alive = chunk != NULL && chunk->cells[(i % CHUNK_SIZE) * CHUNK_SIZE + (j % CHUNK_SIZE)];
+                grid[i * cols + j] = alive ? ALIVE : DEAD;
+            }
+        }
+        return;
+    }
+
+    // Copy the local grid without ghost rows and columns
+    int *local_grid = (gol->rank == 0) ? grid : gol->local_grid;
+    int id = 0;
+    for (int i = 1; i <= gol->local_rows; i++) {
+        for (int j = 1; j <= gol->local_cols; j++) {
+            local_grid[id] = gol->local_grid_wg[i * gol->local_cols_wg + j];
+            id++;
+        }
+    }
+
+    if (!is_distributed(gol) || gol->size == 1) {
+        return;
+    }
+
+    // Process 0 receives the local grids of the other processes
+    int local_size = (rows / gol->size) * cols;
+    if (gol->rank != 0) {
+        MPI_Send(&local_grid[0], gol->local_rows * cols, MPI_INT, 0, 0, gol->comm);
+    } else {
+        for (int i = 1; i < gol->size; i++) {
+            if (i < gol->size - 1) {
+                MPI_Recv(&grid[i * local_size], local_size, MPI_INT, i, 0, gol->comm, MPI_STATUS_IGNORE);
+            } else {
+                MPI_Recv(&grid[i * local_size], local_size + gol->offset * cols, MPI_INT, i, 0, gol->comm, MPI_STATUS_IGNORE);
+            }
+        }
+    }
+}
+
+void gol_destroy(gol_t *gol) {
+    unload_board(gol);
+
+    if (gol->evolution == SPARSE && gol->active) {
+        free_universe(&gol->universe);
+    }
+
+    free(gol->pool);
+    free(gol);
+}
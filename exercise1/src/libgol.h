@@ -0,0 +1,152 @@
+#ifndef LIBGOL_H
+#define LIBGOL_H
+
+#include <mpi.h>
+
+#define ORDERED 0
+#define STATIC 1
+#define BLACK_WHITE_STATIC 2
+#define SPARSE 3
+
+/*
+* Opaque context of a Game of Life board. The grid, the next state grid (with
+* the ghost rows and columns) and the staging buffers used to scatter and gather
+* the grid are carved from a single preallocated pool, that is reused when a new
+* board of the same (or smaller) dimension is loaded.
+*/
+typedef struct gol gol_t;
+
+/**
+ * Create the context of a board that will be evolved by the processes of the
+ * communicator with the given evolution. The ORDERED and SPARSE evolutions are
+ * performed only by rank 0 of the communicator. Collective on comm.
+ *
+ * @param comm: communicator of the processes that own the board
+ * @param evolution: evolution type (ORDERED, STATIC, BLACK_WHITE_STATIC, SPARSE)
+ */
+gol_t *gol_create(MPI_Comm comm, int evolution);
+
+/**
+ * Set after how many evolutions the in-situ statistics are computed (0: never).
+ * It must be called before loading the board.
+ *
+ * @param gol: the context
+ * @param a: analysis frequency
+ */
+void gol_set_analysis(gol_t *gol, int a);
+
+/**
+ * Set how many past states are remembered by the cycle detection (0: no detection).
+ * It must be called before loading the board.
+ *
+ * @param gol: the context
+ * @param c: number of past states
+ */
+void gol_set_cycle_detection(gol_t *gol, int c);
+
+/**
+ * Set the total number of steps printed by rank 0 after each evolution with
+ * this format: Step <step>/<total>, rank 0 also prints the cycles found
+ * (0: nothing is printed).
+ *
+ * @param gol: the context
+ * @param total: total number of steps
+ */
+void gol_set_progress(gol_t *gol, int total);
+
+/**
+ * Load the board from a PGM file (read by rank 0 and scattered among the
+ * processes) and reset the step counter. Collective on comm.
+ *
+ * @param gol: the context
+ * @param file_name: name of the PGM file (without extension)
+ */
+void gol_load(gol_t *gol, char *file_name);
+
+/**
+ * Load the board from a grid of ALIVE (0) and DEAD (255) cells and reset the
+ * step counter. Collective on comm.
+ *
+ * @param gol: the context
+ * @param grid: the grid (significant only on rank 0)
+ * @param rows: number of rows of the grid
+ * @param cols: number of columns of the grid
+ */
+void gol_load_grid(gol_t *gol, int *grid, int rows, int cols);
+
+/**
+ * Perform steps evolutions of the board. After each evolution the cycle detection
+ * and the statistics are performed (if enabled). Once a cycle is found, only the
+ * remaining steps modulo the period are evolved since the state repeats.
+ * Collective on comm.
+ *
+ * @param gol: the context
+ * @param steps: number of evolutions
+ */
+void gol_step(gol_t *gol, int steps);
+
+/**
+ * Save the board in the snapshots folder with this format: snapshot_0000<step>.pgm
+ * Collective on comm.
+ *
+ * @param gol: the context
+ * @param step: the step used in the name of the file
+ */
+void gol_snapshot(gol_t *gol, int step);
+
+/**
+ * Returns the number of evolutions performed since the board was loaded
+ * (including the ones skipped thanks to the cycle detection).
+ *
+ * @param gol: the context
+ */
+int gol_get_step(gol_t *gol);
+
+/**
+ * Returns the period of the cycle found by the cycle detection (0 if not found).
+ *
+ * @param gol: the context
+ */
+int gol_get_period(gol_t *gol);
+
+/**
+ * Returns the number of rows of the board loaded.
+ *
+ * @param gol: the context
+ */
+int gol_get_rows(gol_t *gol);
+
+/**
+ * Returns the number of columns of the board loaded.
+ *
+ * @param gol: the context
+ */
+int gol_get_cols(gol_t *gol);
+
+/**
+ * Returns the number of alive cells of the board (meaningful on the processes
+ * that evolve it). Collective on comm.
+ *
+ * @param gol: the context
+ */
+long long gol_get_population(gol_t *gol);
+
+/**
+ * Gather the current state of the board in a grid of ALIVE (0) and DEAD (255)
+ * cells with the dimension of the loaded board. For the SPARSE evolution the
+ * grid contains the cells of the universe inside the frame of the loaded board.
+ * Collective on comm.
+ *
+ * @param gol: the context
+ * @param grid: the grid of rows x cols cells (significant only on rank 0)
+ */
+void gol_get_grid(gol_t *gol, int *grid);
+
+/**
+ * Free the context and all its buffers.
+ *
+ * @param gol: the context
+ */
+void gol_destroy(gol_t *gol);
+
+#endif
@@ -5,6 +5,8 @@
 #include <sys/stat.h>
 #include <mpi.h>
 
+#include "rw.h"
+
 #define ALIVE 0
 #define DEAD 255
 
@@ -64,6 +66,7 @@ void write_pgm_image(void *image, char *file_name, int rows, int cols) {
     fwrite(image, 1, rows * cols, image_file);  
 
     fclose(image_file); 
+    free(full_path);
     return;
 }
 
@@ -141,7 +144,6 @@ void * generate_gradient_with_input(int *grid, int rows, int cols) {
 
     int id = 0;
 
-    srand(time(NULL));
     for (int i = 0; i < rows; i++ ) {
         for( int j = 0; j < cols; j++ ) {
             cImage[id++] = (char) grid[i * cols + j];
@@ -154,7 +156,6 @@ void * generate_gradient_with_input(int *grid, int rows, int cols) {
 
 
 unsigned char *read_pgm(char *file_name) {
-    int row = 0;
     FILE *fp = fopen(file_name, "rb");
     char magic[3];
     int w, h, mv;
@@ -183,10 +184,13 @@ unsigned char *read_pgm(char *file_name) {
 
 // DONE
 int read_rows(char *file_name) {
-    FILE *fp = fopen(add_pgm_extension(file_name), "rb");
+    char *file_name_with_ext = add_pgm_extension(file_name);
+    FILE *fp = fopen(file_name_with_ext, "rb");
     char magic[3];
     int rows, cols, max_value;
 
+    free(file_name_with_ext);
+
     if (!fp) {
         printf("Error: Unable to open file\n");
         return 1;
@@ -199,15 +203,19 @@ int read_rows(char *file_name) {
         return 1;
     }
 
+    fclose(fp);
     return rows;
 }
 
 // DONE
 int read_cols(char *file_name) {
-    FILE *fp = fopen(add_pgm_extension(file_name), "rb");
+    char *file_name_with_ext = add_pgm_extension(file_name);
+    FILE *fp = fopen(file_name_with_ext, "rb");
     char magic[3];
     int rows, cols, max_value;
 
+    free(file_name_with_ext);
+
     if (!fp) {
         printf("Error: Unable to open file\n");
         return 1;
@@ -220,6 +228,7 @@ int read_cols(char *file_name) {
         return 1;
     }
 
+    fclose(fp);
     return cols;
 }
 
@@ -241,32 +250,43 @@ void generate_image_utils(char *file_name, int width, int height) {
 
 // DONE
 void read_image_utils(int *grid, char *file_name, int rows, int cols) {
-    unsigned char *image_data = read_pgm(add_pgm_extension(file_name));
+    char *file_name_with_ext = add_pgm_extension(file_name);
+    unsigned char *image_data = read_pgm(file_name_with_ext);
 
     for (int i = 0; i < rows * cols; i++) {
         grid[i] = (int) image_data[i];
     }
+
+    free(image_data);
+    free(file_name_with_ext);
 }
 
 // DONE
 void save_image_utils(int * grid, int rows, int cols, int step) {
+    save_named_image_utils(grid, rows, cols, FILE_NAME, step);
+}
+
+void save_named_image_utils(int * grid, int rows, int cols, char *name, int number) {
     void *image = generate_gradient_with_input(grid, rows, cols);
 
-    char *padded_step = pad_with_zeros(step);
+    // The number is padded here since pad_with_zeros uses a static buffer
+    char padded_number[16];
+    sprintf(padded_number, "%05d", number);
 
-    char *full_file_name = (char *) malloc(strlen(FILE_NAME) + strlen(padded_step) + strlen(FILE_FORMAT) + 1);
+    char *full_file_name = (char *) malloc(strlen(name) + strlen(padded_number) + strlen(FILE_FORMAT) + 1);
 
-    strcpy(full_file_name, FILE_NAME);
-    strcat(full_file_name, padded_step);
+    strcpy(full_file_name, name);
+    strcat(full_file_name, padded_number);
     strcat(full_file_name, FILE_FORMAT);
 
     write_pgm_image(image, full_file_name, rows, cols);
-}
 
+    free(image);
+    free(full_file_name);
+}
 
-void save_image(int * local_grid_wg, int local_rows, int local_cols, int rows, int cols, int rank, int size, int offset, int step) {
-    int * local_grid = (int*) malloc(local_rows * local_cols * sizeof(int));
 
+void save_image(int * local_grid_wg, int * local_grid, int * full_grid, int local_rows, int local_cols, int rows, int cols, int rank, int size, int offset, int step, MPI_Comm comm) {
     int id = 0;
     for(int i = 1; i <= local_rows; i++) {
         for(int j = 1; j <= local_cols; j++) {
@@ -276,24 +296,20 @@ void save_image(int * local_grid_wg, int local_rows, int local_cols, int rows, i
     }
 
     if (rank != 0) {
-        MPI_Send(&local_grid[0], local_rows * local_cols, MPI_INT, 0, 0, MPI_COMM_WORLD);
+        MPI_Send(&local_grid[0], local_rows * local_cols, MPI_INT, 0, 0, comm);
     } else {
-        int *full_grid_temp = (int*) malloc(rows * cols * sizeof(int));
-
         for (int i = 0; i < local_rows * local_cols; i++) {
-            full_grid_temp[i] = local_grid[i];
+            full_grid[i] = local_grid[i];
         }
 
         for (int i = 1; i < size; i++) {
             if (i < size - 1) {
-                MPI_Recv(&full_grid_temp[i * local_rows * local_cols], local_rows * local_cols, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                MPI_Recv(&full_grid[i * local_rows * local_cols], local_rows * local_cols, MPI_INT, i, 0, comm, MPI_STATUS_IGNORE);
             } else {
-                MPI_Recv(&full_grid_temp[i * local_rows * local_cols], (local_rows + offset) * local_cols, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                MPI_Recv(&full_grid[i * local_rows * local_cols], (local_rows + offset) * local_cols, MPI_INT, i, 0, comm, MPI_STATUS_IGNORE);
             }
         }
 
-        save_image_utils(full_grid_temp, rows, cols, step);
-
-        free(full_grid_temp);
+        save_image_utils(full_grid, rows, cols, step);
     }  
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef RW_H
 #define RW_H
 
+#include <mpi.h>
+
 /**
 * Given a file_name adds the .pgm extension
 */
@@ -11,6 +13,16 @@ char * add_pgm_extension(char *file_name);
 */
 void create_folder();
 
+/**
+ * Write a PGM image to a file. In this case the file is added to the snapshots folder.
+ *
+ * @param image The image data.
+ * @param file_name The name of the file.
+ * @param rows The number of rows.
+ * @param cols The number of columns.
+ */
+void write_pgm_image(void *image, char *file_name, int rows, int cols);
+
 
 /**
  * Given a PGM file, read the image data and return it as an array of unsigned
@@ -56,7 +68,25 @@ void generate_image_utils(char *file_name, int rows, int cols);
 void read_image_utils(int *grid, char *file_name, int rows, int cols);
 
 
-void save_image(int * local_grid_wg, int local_rows, int local_cols, int rows, int cols, int rank, int size, int offset, int step);
+/**
+ * Given the local grid with ghost rows and columns of each process, gather the
+ * full grid on rank 0 and save it with save_image_utils. The staging buffers are
+ * provided by the caller so that no memory is allocated at each snapshot.
+ *
+ * @param local_grid_wg The local grid with ghost rows and columns.
+ * @param local_grid Staging buffer for the local grid without ghost rows and columns.
+ * @param full_grid Staging buffer for the full grid (used only by rank 0).
+ * @param local_rows The number of rows of the local grid.
+ * @param local_cols The number of columns of the local grid.
+ * @param rows The number of rows of the full grid.
+ * @param cols The number of columns of the full grid.
+ * @param rank The rank of the process.
+ * @param size The number of processes.
+ * @param offset The number of extra rows of the last process.
+ * @param step The step of the simulation.
+ * @param comm The communicator of the processes that own the grid.
+ */
+void save_image(int * local_grid_wg, int * local_grid, int * full_grid, int local_rows, int local_cols, int rows, int cols, int rank, int size, int offset, int step, MPI_Comm comm);
 
 /**
  * Given a file_name and the dimension save a PGM file with the specified
@@ -69,4 +99,16 @@ void save_image(int * local_grid_wg, int local_rows, int local_cols, int rows, i
  */
 void save_image_utils(int * grid, int rows, int cols, int step);
 
+/**
+ * Given a file_name and the dimension save a PGM file with the specified
+ * in the snapshop folder with this format: <name>0000<number>.pgm
+ *
+ * @param grid The grid to save.
+ * @param rows The number of rows.
+ * @param cols The number of columns.
+ * @param name The prefix of the file name.
+ * @param number The number appended to the file name.
+ */
+void save_named_image_utils(int * grid, int rows, int cols, char *name, int number);
+
 #endif
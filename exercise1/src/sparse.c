@@ -0,0 +1,429 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cycle.h"
+#include "rw.h"
+#include "sparse.h"
+
+#define ALIVE 0
+#define DEAD 255
+
+#define INITIAL_BUCKETS 1024
+
+// Freed chunks kept for reuse, the others are released to the system
+#define MAX_FREE_CHUNKS 64
+
+/**
+ * Floor division (also for negative numbers), used to find the chunk of a cell.
+ *
+ * @param a The dividend.
+ * @param b The divisor (positive).
+ */
+int floor_div(int a, int b) {
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+/**
+ * Given the coordinates of a chunk, returns the bucket of the hash table.
+ *
+ * @param universe The universe.
+ * @param row The row of the chunk.
+ * @param col The column of the chunk.
+ */
+int chunk_bucket(universe_t *universe, int row, int col) {
+    unsigned long long key = ((unsigned long long) (unsigned int) row << 32) | (unsigned int) col;
+    return (int) (mix_hash(key) & (universe->buckets - 1));
+}
+
+/**
+ * Change the number of buckets of the hash table and move the chunks in the new buckets.
+ *
+ * @param universe The universe.
+ * @param buckets The new number of buckets (power of 2).
+ */
+void resize_table(universe_t *universe, int buckets) {
+    free(universe->table);
+
+    universe->buckets = buckets;
+    universe->table = (chunk_t **) calloc(universe->buckets, sizeof(chunk_t *));
+
+    for (int id = 0; id < universe->count; id++) {
+        chunk_t *chunk = universe->chunks[id];
+        int bucket = chunk_bucket(universe, chunk->row, chunk->col);
+        chunk->bucket_next = universe->table[bucket];
+        universe->table[bucket] = chunk;
+    }
+}
+
+/**
+ * Allocate an empty chunk (reusing a free one if possible) with the given
+ * coordinates and add it to the universe.
+ *
+ * @param universe The universe.
+ * @param row The row of the chunk.
+ * @param col The column of the chunk.
+ */
+chunk_t *add_chunk(universe_t *universe, int row, int col) {
+    chunk_t *chunk = universe->free_chunks;
+    if (chunk != NULL) {
+        universe->free_chunks = chunk->bucket_next;
+        universe->free_count--;
+        memset(chunk, 0, sizeof(chunk_t));
+    } else {
+        chunk = (chunk_t *) calloc(1, sizeof(chunk_t));
+    }
+    chunk->row = row;
+    chunk->col = col;
+
+    if (universe->count == universe->capacity) {
+        universe->capacity *= 2;
+        universe->chunks = (chunk_t **) realloc(universe->chunks, universe->capacity * sizeof(chunk_t *));
+    }
+    chunk->id = universe->count;
+    universe->chunks[universe->count++] = chunk;
+
+    if (universe->count > universe->buckets) {
+        // The new chunk is added to its bucket while growing
+        resize_table(universe, universe->buckets * 2);
+    } else {
+        int bucket = chunk_bucket(universe, row, col);
+        chunk->bucket_next = universe->table[bucket];
+        universe->table[bucket] = chunk;
+    }
+
+    return chunk;
+}
+
+/**
+ * Remove a chunk from the hash table and from the array of chunks and move it
+ * to the list of the free chunks (or free it if the list is full).
+ *
+ * @param universe The universe.
+ * @param chunk The chunk to remove.
+ */
+void remove_chunk(universe_t *universe, chunk_t *chunk) {
+    chunk_t **link = &universe->table[chunk_bucket(universe, chunk->row, chunk->col)];
+    while (*link != chunk) {
+        link = &(*link)->bucket_next;
+    }
+    *link = chunk->bucket_next;
+
+    // The last chunk of the array takes the place of the removed one
+    chunk_t *last = universe->chunks[--universe->count];
+    last->id = chunk->id;
+    universe->chunks[chunk->id] = last;
+
+    if (universe->free_count < MAX_FREE_CHUNKS) {
+        chunk->bucket_next = universe->free_chunks;
+        universe->free_chunks = chunk;
+        universe->free_count++;
+    } else {
+        free(chunk);
+    }
+}
+
+/**
+ * Halve the hash table and the array of chunks while they are used for less
+ * than a quarter, so the memory follows the live population and not the peak.
+ *
+ * @param universe The universe.
+ */
+void shrink_universe(universe_t *universe) {
+    int buckets = universe->buckets;
+    while (buckets > INITIAL_BUCKETS && universe->count < buckets / 4) {
+        buckets /= 2;
+    }
+    if (buckets != universe->buckets) {
+        resize_table(universe, buckets);
+    }
+
+    int capacity = universe->capacity;
+    while (capacity > INITIAL_BUCKETS && universe->count < capacity / 4) {
+        capacity /= 2;
+    }
+    if (capacity != universe->capacity) {
+        universe->capacity = capacity;
+        universe->chunks = (chunk_t **) realloc(universe->chunks, capacity * sizeof(chunk_t *));
+    }
+}
+
+/**
+ * Returns the chunk with the given coordinates allocating it if needed.
+ *
+ * @param universe The universe.
+ * @param row The row of the chunk.
+ * @param col The column of the chunk.
+ */
+chunk_t *get_or_add_chunk(universe_t *universe, int row, int col) {
+    chunk_t *chunk = get_chunk(universe, row, col);
+    return chunk != NULL ? chunk : add_chunk(universe, row, col);
+}
+
+void init_universe(universe_t *universe) {
+    universe->buckets = INITIAL_BUCKETS;
+    universe->table = (chunk_t **) calloc(universe->buckets, sizeof(chunk_t *));
+    universe->capacity = INITIAL_BUCKETS;
+    universe->chunks = (chunk_t **) malloc(universe->capacity * sizeof(chunk_t *));
+    universe->count = 0;
+    universe->population = 0;
+    universe->free_chunks = NULL;
+    universe->free_count = 0;
+}
+
+void free_universe(universe_t *universe) {
+    for (int id = 0; id < universe->count; id++) {
+        free(universe->chunks[id]);
+    }
+    while (universe->free_chunks != NULL) {
+        chunk_t *chunk = universe->free_chunks;
+        universe->free_chunks = chunk->bucket_next;
+        free(chunk);
+    }
+    free(universe->chunks);
+    free(universe->table);
+}
+
+chunk_t *get_chunk(universe_t *universe, int row, int col) {
+    chunk_t *chunk = universe->table[chunk_bucket(universe, row, col)];
+    while (chunk != NULL && (chunk->row != row || chunk->col != col)) {
+        chunk = chunk->bucket_next;
+    }
+    return chunk;
+}
+
+void set_cell(universe_t *universe, int i, int j, int alive) {
+    int row = floor_div(i, CHUNK_SIZE);
+    int col = floor_div(j, CHUNK_SIZE);
+    chunk_t *chunk = get_or_add_chunk(universe, row, col);
+
+    unsigned char *cell = &chunk->cells[(i - row * CHUNK_SIZE) * CHUNK_SIZE + (j - col * CHUNK_SIZE)];
+    chunk->population += (alive != 0) - *cell;
+    universe->population += (alive != 0) - *cell;
+    *cell = (alive != 0);
+}
+
+/**
+ * Allocate the (empty) neighbor chunks that will be reached by the alive cells
+ * on the border of the chunk in the next step.
+ *
+ * @param universe The universe.
+ * @param chunk The chunk.
+ */
+void expand_chunk(universe_t *universe, chunk_t *chunk) {
+    unsigned char *cells = chunk->cells;
+    int last = CHUNK_SIZE - 1;
+    int top = 0, bottom = 0, left = 0, right = 0;
+
+    for (int l = 0; l < CHUNK_SIZE; l++) {
+        top |= cells[l];
+        bottom |= cells[last * CHUNK_SIZE + l];
+        left |= cells[l * CHUNK_SIZE];
+        right |= cells[l * CHUNK_SIZE + last];
+    }
+
+    int row = chunk->row;
+    int col = chunk->col;
+
+    if (top) get_or_add_chunk(universe, row - 1, col);
+    if (bottom) get_or_add_chunk(universe, row + 1, col);
+    if (left) get_or_add_chunk(universe, row, col - 1);
+    if (right) get_or_add_chunk(universe, row, col + 1);
+    if (cells[0]) get_or_add_chunk(universe, row - 1, col - 1);
+    if (cells[last]) get_or_add_chunk(universe, row - 1, col + 1);
+    if (cells[last * CHUNK_SIZE]) get_or_add_chunk(universe, row + 1, col - 1);
+    if (cells[last * CHUNK_SIZE + last]) get_or_add_chunk(universe, row + 1, col + 1);
+}
+
+/**
+ * Compute the next state of a chunk. The chunk and the border of its neighbors
+ * are copied in a grid with ghost rows and columns, then the usual rules are applied.
+ *
+ * @param chunk The chunk (with the neighbors already linked).
+ */
+void evolve_chunk(chunk_t *chunk) {
+    int cols_wg = CHUNK_SIZE + 2;
+    unsigned char grid_wg[(CHUNK_SIZE + 2) * (CHUNK_SIZE + 2)];
+    memset(grid_wg, 0, sizeof(grid_wg));
+
+    // Neighbor n = (dr + 1) * 3 + (dc + 1) covers the ghost cells in direction (dr, dc)
+    for (int dr = -1; dr <= 1; dr++) {
+        for (int dc = -1; dc <= 1; dc++) {
+            chunk_t *neighbor = chunk->neighbors[(dr + 1) * 3 + (dc + 1)];
+            if (neighbor == NULL) continue;
+
+            int i_start = (dr == -1) ? CHUNK_SIZE - 1 : 0;
+            int i_end = (dr == 1) ? 1 : CHUNK_SIZE;
+            int j_start = (dc == -1) ? CHUNK_SIZE - 1 : 0;
+            int j_end = (dc == 1) ? 1 : CHUNK_SIZE;
+
+            for (int i = i_start; i < i_end; i++) {
+                for (int j = j_start; j < j_end; j++) {
+                    int i_wg = i + 1 + dr * CHUNK_SIZE;
+                    int j_wg = j + 1 + dc * CHUNK_SIZE;
+                    grid_wg[i_wg * cols_wg + j_wg] = neighbor->cells[i * CHUNK_SIZE + j];
+                }
+            }
+        }
+    }
+
+    int population = 0;
+    for (int i = 1; i <= CHUNK_SIZE; i++) {
+        for (int j = 1; j <= CHUNK_SIZE; j++) {
+            unsigned char *cell = &grid_wg[i * cols_wg + j];
+            int count = cell[-cols_wg - 1] + cell[-cols_wg] + cell[-cols_wg + 1]
+                      + cell[-1] + cell[1]
+                      + cell[cols_wg - 1] + cell[cols_wg] + cell[cols_wg + 1];
+            unsigned char alive = (count == 3) || (count == 2 && *cell);
+            chunk->next[(i - 1) * CHUNK_SIZE + (j - 1)] = alive;
+            population += alive;
+        }
+    }
+
+    chunk->population = population;
+}
+
+void sparse_evolution(universe_t *universe) {
+    // Allocate the chunks reached by the pattern (the new ones are empty, so
+    // only the chunks that existed at the beginning have to be checked)
+    int count = universe->count;
+    for (int id = 0; id < count; id++) {
+        if (universe->chunks[id]->population > 0) {
+            expand_chunk(universe, universe->chunks[id]);
+        }
+    }
+
+    // Link the neighbors of each chunk
+    #pragma omp parallel for schedule(static)
+    for (int id = 0; id < universe->count; id++) {
+        chunk_t *chunk = universe->chunks[id];
+        for (int dr = -1; dr <= 1; dr++) {
+            for (int dc = -1; dc <= 1; dc++) {
+                chunk->neighbors[(dr + 1) * 3 + (dc + 1)] = get_chunk(universe, chunk->row + dr, chunk->col + dc);
+            }
+        }
+    }
+
+    // Perform the evolution
+    long long population = 0;
+    #pragma omp parallel for schedule(dynamic) reduction(+:population)
+    for (int id = 0; id < universe->count; id++) {
+        evolve_chunk(universe->chunks[id]);
+        population += universe->chunks[id]->population;
+    }
+
+    // Copy the new state to the current state
+    #pragma omp parallel for schedule(static)
+    for (int id = 0; id < universe->count; id++) {
+        chunk_t *chunk = universe->chunks[id];
+        memcpy(chunk->cells, chunk->next, sizeof(chunk->cells));
+    }
+
+    // Free the empty chunks (backwards, since the last chunk takes the place of the removed one)
+    for (int id = universe->count - 1; id >= 0; id--) {
+        if (universe->chunks[id]->population == 0) {
+            remove_chunk(universe, universe->chunks[id]);
+        }
+    }
+    shrink_universe(universe);
+
+    universe->population = population;
+}
+
+board_hash_t hash_universe(universe_t *universe) {
+    unsigned long long first = 0, second = 0;
+
+    #pragma omp parallel for schedule(static) reduction(+:first, second)
+    for (int id = 0; id < universe->count; id++) {
+        chunk_t *chunk = universe->chunks[id];
+        if (chunk->population == 0) continue;
+
+        unsigned long long key = ((unsigned long long) (unsigned int) chunk->row << 32) | (unsigned int) chunk->col;
+        unsigned long long chunk_hash = mix_hash(key);
+        unsigned long long chunk_second = mix_hash_second(~key);
+
+        // The cells are packed 64 at a time (a row of the chunk) in a word before being mixed
+        for (int i = 0; i < CHUNK_SIZE; i++) {
+            unsigned long long word = 0;
+            for (int j = 0; j < CHUNK_SIZE; j++) {
+                word = (word << 1) | chunk->cells[i * CHUNK_SIZE + j];
+            }
+            chunk_hash = mix_hash(chunk_hash ^ word);
+            chunk_second = mix_hash_second(chunk_second + word);
+        }
+
+        first += chunk_hash;
+        second += chunk_second;
+    }
+
+    board_hash_t hash = { first, second };
+    return hash;
+}
+
+void compute_universe_stats(universe_t *universe, stats_t *stats) {
+    int min_row = INT_MAX, max_row = INT_MIN;
+    int min_col = INT_MAX, max_col = INT_MIN;
+
+    #pragma omp parallel for schedule(dynamic) reduction(min:min_row, min_col) reduction(max:max_row, max_col)
+    for (int id = 0; id < universe->count; id++) {
+        chunk_t *chunk = universe->chunks[id];
+        if (chunk->population == 0) continue;
+
+        for (int i = 0; i < CHUNK_SIZE; i++) {
+            for (int j = 0; j < CHUNK_SIZE; j++) {
+                if (chunk->cells[i * CHUNK_SIZE + j]) {
+                    int row = chunk->row * CHUNK_SIZE + i;
+                    int col = chunk->col * CHUNK_SIZE + j;
+                    if (row < min_row) min_row = row;
+                    if (row > max_row) max_row = row;
+                    if (col < min_col) min_col = col;
+                    if (col > max_col) max_col = col;
+                }
+            }
+        }
+    }
+
+    stats->population = universe->population;
+    stats->min_row = min_row;
+    stats->max_row = max_row;
+    stats->min_col = min_col;
+    stats->max_col = max_col;
+}
+
+void save_universe_utils(universe_t *universe, int step) {
+    stats_t stats;
+    compute_universe_stats(universe, &stats);
+
+    // An empty universe is saved as a single dead cell
+    if (stats.population == 0) {
+        int dead = DEAD;
+        save_image_utils(&dead, 1, 1, step);
+        return;
+    }
+
+    int rows = stats.max_row - stats.min_row + 1;
+    int cols = stats.max_col - stats.min_col + 1;
+    int *grid = (int *) malloc((long long) rows * cols * sizeof(int));
+
+    for (int i = 0; i < rows * cols; i++) {
+        grid[i] = DEAD;
+    }
+
+    for (int id = 0; id < universe->count; id++) {
+        chunk_t *chunk = universe->chunks[id];
+        for (int i = 0; i < CHUNK_SIZE; i++) {
+            for (int j = 0; j < CHUNK_SIZE; j++) {
+                if (chunk->cells[i * CHUNK_SIZE + j]) {
+                    int row = chunk->row * CHUNK_SIZE + i - stats.min_row;
+                    int col = chunk->col * CHUNK_SIZE + j - stats.min_col;
+                    grid[row * cols + col] = ALIVE;
+                }
+            }
+        }
+    }
+
+    save_image_utils(grid, rows, cols, step);
+
+    free(grid);
+}
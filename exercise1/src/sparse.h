@@ -0,0 +1,125 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include "stats.h"
+#include "cycle.h"
+
+#define CHUNK_SIZE 64
+
+/*
+* row, col: coordinates of the chunk (the cell (i, j) belongs to the chunk (i / CHUNK_SIZE, j / CHUNK_SIZE))
+* population: number of alive cells of the chunk
+* cells: state of the cells (1 alive, 0 dead)
+* next: next state of the cells
+* neighbors: the 3x3 chunks around the chunk (itself in the middle), NULL if not allocated
+* bucket_next: next chunk in the same bucket of the hash table
+* id: position of the chunk in the array of chunks
+*/
+typedef struct chunk {
+    int row;
+    int col;
+    int population;
+    unsigned char cells[CHUNK_SIZE * CHUNK_SIZE];
+    unsigned char next[CHUNK_SIZE * CHUNK_SIZE];
+    struct chunk *neighbors[9];
+    struct chunk *bucket_next;
+    int id;
+} chunk_t;
+
+/*
+* buckets: number of buckets of the hash table (power of 2)
+* table: hash table of the chunks indexed by their coordinates
+* chunks: array of the allocated chunks (used to iterate over them)
+* count: number of allocated chunks
+* capacity: capacity of the array of chunks
+* population: number of alive cells of the universe
+* free_chunks: list of the freed chunks (linked by bucket_next) that are reused
+*              before allocating new ones, at most MAX_FREE_CHUNKS (the others are freed)
+* free_count: number of chunks in the list of the freed chunks
+*/
+typedef struct {
+    int buckets;
+    chunk_t **table;
+    chunk_t **chunks;
+    int count;
+    int capacity;
+    long long population;
+    chunk_t *free_chunks;
+    int free_count;
+} universe_t;
+
+/**
+ * Initialize an empty unbounded universe.
+ *
+ * @param universe: universe to initialize
+ */
+void init_universe(universe_t *universe);
+
+/**
+ * Free all the chunks and the hash table of the universe.
+ *
+ * @param universe: universe to free
+ */
+void free_universe(universe_t *universe);
+
+/**
+ * Given the coordinates of a chunk, returns the chunk or NULL if it is not allocated.
+ *
+ * @param universe: the universe
+ * @param row: row of the chunk
+ * @param col: column of the chunk
+ */
+chunk_t *get_chunk(universe_t *universe, int row, int col);
+
+/**
+ * Given the coordinates of a cell (also negative), set its state allocating the
+ * chunk that contains it if needed.
+ *
+ * @param universe: the universe
+ * @param i: row of the cell
+ * @param j: column of the cell
+ * @param alive: 1 if the cell is alive, 0 otherwise
+ */
+void set_cell(universe_t *universe, int i, int j, int alive);
+
+/**
+ * Compute the next state of the unbounded universe (non periodic):
+ * - allocate the empty chunks that are touched by alive cells on the border of a chunk
+ * - for each chunk (in parallel), compute the next state of its cells using the
+ *   3x3 neighbor chunks (a missing chunk contains only dead cells)
+ * - free the chunks that have no alive cells
+ * The cost of a step depends on the number of chunks with alive cells and not on
+ * the bounding box of the pattern.
+ *
+ * @param universe: the universe
+ */
+void sparse_evolution(universe_t *universe);
+
+/**
+ * Compute the two hashes of the universe summing the hashes of its chunks (each
+ * one hashed together with its coordinates), to be used with detect_cycle.
+ *
+ * @param universe: the universe
+ */
+board_hash_t hash_universe(universe_t *universe);
+
+/**
+ * Compute the population and the bounding box of the universe. The heatmap is not
+ * computed since the universe has no fixed dimension.
+ *
+ * @param universe: the universe
+ * @param stats: statistics initialized with init_stats(stats, 0, 0)
+ */
+void compute_universe_stats(universe_t *universe, stats_t *stats);
+
+/**
+ * Save the bounding box of the alive cells of the universe in the snapshots folder
+ * with this format: snapshot_0000<step>.pgm. The coordinates of the bounding box
+ * are reported by the statistics.
+ *
+ * @param universe: the universe
+ * @param step: the step of the simulation
+ */
+void save_universe_utils(universe_t *universe, int step);
+
+#endif
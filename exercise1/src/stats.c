@@ -0,0 +1,198 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "rw.h"
+#include "stats.h"
+
+#define ALIVE 0
+#define DEAD 255
+
+#define STATS_FILE_NAME "stats.csv"
+#define HEATMAP_FILE_NAME "heatmap"
+#define FOLDER_NAME "snapshots"
+
+void init_stats(stats_t *stats, int rows, int cols) {
+    stats->heat_rows = rows < HEATMAP_SIZE ? rows : HEATMAP_SIZE;
+    stats->heat_cols = cols < HEATMAP_SIZE ? cols : HEATMAP_SIZE;
+
+    stats->bin_rows = (int *) calloc(stats->heat_rows, sizeof(int));
+    stats->bin_cols = (int *) calloc(stats->heat_cols, sizeof(int));
+    stats->heatmap = (long long *) calloc(stats->heat_rows * stats->heat_cols, sizeof(long long));
+
+    // Row i of the grid falls in the heatmap row i * heat_rows / rows
+    for (int i = 0; i < rows; i++) {
+        stats->bin_rows[(long long) i * stats->heat_rows / rows]++;
+    }
+    for (int j = 0; j < cols; j++) {
+        stats->bin_cols[(long long) j * stats->heat_cols / cols]++;
+    }
+
+    stats->population = 0;
+    stats->min_row = INT_MAX;
+    stats->max_row = -1;
+    stats->min_col = INT_MAX;
+    stats->max_col = -1;
+}
+
+void free_stats(stats_t *stats) {
+    free(stats->bin_rows);
+    free(stats->bin_cols);
+    free(stats->heatmap);
+}
+
+void compute_local_stats(stats_t *stats, int *local_grid_wg, int local_rows, int local_cols, int row_start, int rows, int cols) {
+    int local_cols_wg = local_cols + 2;
+    int heat_rows = stats->heat_rows;
+    int heat_cols = stats->heat_cols;
+    long long *heatmap = stats->heatmap;
+
+    long long population = 0;
+    int min_row = INT_MAX, max_row = -1;
+    int min_col = INT_MAX, max_col = -1;
+
+    memset(heatmap, 0, heat_rows * heat_cols * sizeof(long long));
+
+    #pragma omp parallel for schedule(static) reduction(+:population) reduction(min:min_row, min_col) reduction(max:max_row, max_col)
+    for (int i = 0; i < local_rows; i++) {
+        // Alive cells of the row are first counted per heatmap column and
+        // then added to the shared heatmap (one atomic per bin instead of per cell)
+        long long row_bins[HEATMAP_SIZE] = {0};
+        long long row_population = 0;
+        int row_min_col = INT_MAX, row_max_col = -1;
+        int *row = &local_grid_wg[(i + 1) * local_cols_wg + 1];
+
+        for (int j = 0; j < local_cols; j++) {
+            if (row[j] == ALIVE) {
+                row_bins[(long long) j * heat_cols / cols]++;
+                row_population++;
+                if (j < row_min_col) row_min_col = j;
+                row_max_col = j;
+            }
+        }
+
+        if (row_population == 0) continue;
+
+        int global_row = row_start + i;
+        long long *heat_row = &heatmap[((long long) global_row * heat_rows / rows) * heat_cols];
+        for (int b = 0; b < heat_cols; b++) {
+            if (row_bins[b] != 0) {
+                #pragma omp atomic
+                heat_row[b] += row_bins[b];
+            }
+        }
+
+        population += row_population;
+        if (global_row < min_row) min_row = global_row;
+        if (global_row > max_row) max_row = global_row;
+        if (row_min_col < min_col) min_col = row_min_col;
+        if (row_max_col > max_col) max_col = row_max_col;
+    }
+
+    stats->population = population;
+    stats->min_row = min_row;
+    stats->max_row = max_row;
+    stats->min_col = min_col;
+    stats->max_col = max_col;
+}
+
+void reduce_stats(stats_t *local, stats_t *global, MPI_Comm comm) {
+    // The max of the bounding box is reduced with MPI_MIN on the negated values
+    // so that a single reduction is enough
+    int local_box[4] = {local->min_row, local->min_col, -local->max_row, -local->max_col};
+    int global_box[4];
+
+    MPI_Reduce(&local->population, &global->population, 1, MPI_LONG_LONG, MPI_SUM, 0, comm);
+    MPI_Reduce(local_box, global_box, 4, MPI_INT, MPI_MIN, 0, comm);
+    MPI_Reduce(local->heatmap, global->heatmap, local->heat_rows * local->heat_cols, MPI_LONG_LONG, MPI_SUM, 0, comm);
+
+    global->min_row = global_box[0];
+    global->min_col = global_box[1];
+    global->max_row = -global_box[2];
+    global->max_col = -global_box[3];
+}
+
+void compute_stats(stats_t *local, stats_t *global, int *local_grid_wg, int local_rows, int local_cols, int row_start, int rows, int cols, int step, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    compute_local_stats(local, local_grid_wg, local_rows, local_cols, row_start, rows, cols);
+    reduce_stats(local, global, comm);
+
+    if (rank == 0) {
+        save_stats_utils(global, rows, cols, step);
+    }
+}
+
+/**
+ * Open a file of the snapshots folder with the given mode.
+ *
+ * @param file_name The name of the file.
+ * @param mode The mode used by fopen.
+ */
+FILE *open_stats_file(char *file_name, char *mode) {
+    create_folder();
+
+    char *full_path = malloc(strlen(FOLDER_NAME) + strlen(file_name) + 2);
+    strcpy(full_path, FOLDER_NAME);
+    strcat(full_path, "/");
+    strcat(full_path, file_name);
+
+    FILE *fp = fopen(full_path, mode);
+    free(full_path);
+
+    if (!fp) {
+        printf("Error: Unable to open file %s\n", file_name);
+    }
+
+    return fp;
+}
+
+void create_stats_file() {
+    FILE *fp = open_stats_file(STATS_FILE_NAME, "w");
+    if (!fp) return;
+
+    fprintf(fp, "step, population, density, min_row, max_row, min_col, max_col\n");
+    fclose(fp);
+}
+
+void save_stats_utils(stats_t *stats, int rows, int cols, int step) {
+    FILE *fp = open_stats_file(STATS_FILE_NAME, "a");
+    if (!fp) return;
+
+    // An empty grid has no bounding box
+    if (stats->population == 0) {
+        fprintf(fp, "%d, 0, 0.000000, -1, -1, -1, -1\n", step);
+    } else {
+        double area = (rows > 0) ? (double) rows * cols
+            : ((double) stats->max_row - stats->min_row + 1) * ((double) stats->max_col - stats->min_col + 1);
+        fprintf(fp, "%d, %lld, %lf, %d, %d, %d, %d\n", step, stats->population,
+            (double) stats->population / area,
+            stats->min_row, stats->max_row, stats->min_col, stats->max_col);
+    }
+    fclose(fp);
+
+    if (stats->heat_rows == 0) {
+        return;
+    }
+
+    // Heatmap image: the density of each bin is mapped from DEAD (empty) to ALIVE (full)
+    int heat_rows = stats->heat_rows;
+    int heat_cols = stats->heat_cols;
+    unsigned char *image = (unsigned char *) malloc(heat_rows * heat_cols);
+
+    for (int i = 0; i < heat_rows; i++) {
+        for (int j = 0; j < heat_cols; j++) {
+            double density = (double) stats->heatmap[i * heat_cols + j] / ((double) stats->bin_rows[i] * stats->bin_cols[j]);
+            image[i * heat_cols + j] = (unsigned char) (DEAD - density * (DEAD - ALIVE));
+        }
+    }
+
+    char file_name[64];
+    sprintf(file_name, "%s%05d.pgm", HEATMAP_FILE_NAME, step);
+    write_pgm_image(image, file_name, heat_rows, heat_cols);
+
+    free(image);
+}
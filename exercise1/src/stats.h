@@ -0,0 +1,110 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <mpi.h>
+
+#define HEATMAP_SIZE 256
+
+/*
+* population: number of alive cells
+* min_row, max_row, min_col, max_col: bounding box of the alive cells (global coordinates)
+* heat_rows, heat_cols: dimension of the coarse density heatmap
+* bin_rows, bin_cols: number of grid rows (columns) that fall in each heatmap row (column)
+* heatmap: number of alive cells in each bin of the heatmap
+*/
+typedef struct {
+    long long population;
+    int min_row;
+    int max_row;
+    int min_col;
+    int max_col;
+    int heat_rows;
+    int heat_cols;
+    int *bin_rows;
+    int *bin_cols;
+    long long *heatmap;
+} stats_t;
+
+/**
+ * Given the dimension of the full grid, allocate the heatmap and compute the
+ * number of grid rows and columns that fall in each bin of the heatmap.
+ * The heatmap has at most HEATMAP_SIZE x HEATMAP_SIZE bins.
+ *
+ * @param stats: statistics to initialize
+ * @param rows: number of rows of the full grid
+ * @param cols: number of columns of the full grid
+ */
+void init_stats(stats_t *stats, int rows, int cols);
+
+/**
+ * Free the memory allocated by init_stats.
+ *
+ * @param stats: statistics to free
+ */
+void free_stats(stats_t *stats);
+
+/**
+ * Given the local grid with ghost rows and columns, compute the population, the
+ * bounding box and the heatmap of the local grid. The coordinates are global so
+ * that the local statistics of all the processes can be reduced.
+ *
+ * @param stats: statistics initialized with init_stats
+ * @param local_grid_wg: local grid with ghost rows and columns
+ * @param local_rows: number of rows of the local grid
+ * @param local_cols: number of columns of the local grid
+ * @param row_start: global index of the first row of the local grid
+ * @param rows: number of rows of the full grid
+ * @param cols: number of columns of the full grid
+ */
+void compute_local_stats(stats_t *stats, int *local_grid_wg, int local_rows, int local_cols, int row_start, int rows, int cols);
+
+/**
+ * Reduce the local statistics of all the processes of the communicator on rank 0
+ * using MPI_Reduce (sum of the population and of the heatmap, min and max of the
+ * bounding box). Only rank 0 receives the result in the global statistics.
+ *
+ * @param local: local statistics of the process
+ * @param global: global statistics (meaningful only on rank 0)
+ * @param comm: communicator of the processes that own the grid
+ */
+void reduce_stats(stats_t *local, stats_t *global, MPI_Comm comm);
+
+/**
+ * Compute the local statistics, reduce them on rank 0 of the communicator and
+ * let rank 0 append them to the time series. This is the in-situ analysis stage
+ * performed every a evolutions instead of gathering the full grid.
+ *
+ * @param local: local statistics of the process
+ * @param global: global statistics (meaningful only on rank 0)
+ * @param local_grid_wg: local grid with ghost rows and columns
+ * @param local_rows: number of rows of the local grid
+ * @param local_cols: number of columns of the local grid
+ * @param row_start: global index of the first row of the local grid
+ * @param rows: number of rows of the full grid
+ * @param cols: number of columns of the full grid
+ * @param step: the step of the simulation
+ * @param comm: communicator of the processes that own the grid
+ */
+void compute_stats(stats_t *local, stats_t *global, int *local_grid_wg, int local_rows, int local_cols, int row_start, int rows, int cols, int step, MPI_Comm comm);
+
+/**
+ * Truncate the statistics time series (stats.csv in the snapshots folder) and
+ * write its header.
+ */
+void create_stats_file();
+
+/**
+ * Append the global statistics to the time series (stats.csv) and save the
+ * heatmap in the snapshots folder as heatmap<step>.pgm, with the step zero-padded
+ * to 5 digits, e.g. heatmap00010.pgm (the darker the bin the higher the density).
+ * If the grid has no fixed dimension (rows and cols equal to 0, unbounded universe)
+ * the density is relative to the bounding box and no heatmap is saved.
+ *
+ * @param stats: global statistics
+ * @param rows: number of rows of the full grid
+ * @param cols: number of columns of the full grid
+ * @param step: the step of the simulation
+ */
+void save_stats_utils(stats_t *stats, int rows, int cols, int step);
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * Allocation of the matrices.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "alloc.h"
+
+#define HUGE_PAGE (2UL << 20)
+
+/* from linux/mempolicy.h, the mbind syscall is called directly (no libnuma) */
+#define MPOL_INTERLEAVE 3
+#define MAX_NODES 1024
+
+#define NODES_ONLINE "/sys/devices/system/node/online"
+
+#define BITS (8 * sizeof(unsigned long))
+
+int parse_policy(const char *name, enum alloc_policy *policy)
+{
+    if (strcmp(name, "first") == 0)
+        *policy = ALLOC_FIRST_TOUCH;
+    else if (strcmp(name, "interleave") == 0)
+        *policy = ALLOC_INTERLEAVE;
+    else if (strcmp(name, "huge") == 0)
+        *policy = ALLOC_HUGE;
+    else
+        return -1;
+    return 0;
+}
+
+/*
+ * Read the mask of the online NUMA nodes (a list of ranges, e.g. 0-3,6).
+ * Returns the highest node + 1, 0 if the list can't be read.
+ */
+static int online_nodes(unsigned long *mask)
+{
+    char line[4096], *item, *save;
+    int first, last, node, max = 0;
+    FILE *fp = fopen(NODES_ONLINE, "r");
+
+    memset(mask, 0, MAX_NODES / 8);
+    if (fp == NULL)
+        return 0;
+    if (fgets(line, sizeof(line), fp) == NULL) {
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+
+    for (item = strtok_r(line, ",\n", &save); item != NULL; item = strtok_r(NULL, ",\n", &save)) {
+        if (sscanf(item, "%d-%d", &first, &last) != 2) {
+            if (sscanf(item, "%d", &first) != 1)
+                continue;
+            last = first;
+        }
+        for (node = first; node <= last && node < MAX_NODES; node++) {
+            mask[node / BITS] |= 1UL << (node % BITS);
+            if (node + 1 > max)
+                max = node + 1;
+        }
+    }
+    return max;
+}
+
+int alloc_buffer(struct buffer *buf, size_t size, enum alloc_policy policy, size_t alignment)
+{
+    memset(buf, 0, sizeof(*buf));
+    if (size == 0)
+        return 0;
+
+    if (policy == ALLOC_FIRST_TOUCH) {
+        if (alignment == 0) {
+            buf->base = malloc(size);
+        } else if (posix_memalign(&buf->base, alignment < sizeof(void *) ? sizeof(void *) : alignment, size) != 0) {
+            buf->base = NULL;
+        }
+        buf->ptr = buf->base;
+        buf->size = size;
+        return (buf->ptr == NULL) ? -1 : 0;
+    }
+
+    /* whole pages for mmap */
+    size = (size + sysconf(_SC_PAGESIZE) - 1) / sysconf(_SC_PAGESIZE) * sysconf(_SC_PAGESIZE);
+
+    if (policy == ALLOC_HUGE) {
+        /* map a huge page more and keep the aligned part */
+        char *base = (char *)mmap(NULL, size + HUGE_PAGE, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        char *ptr;
+        size_t head;
+
+        if (base == MAP_FAILED)
+            return -1;
+        ptr = (char *)(((unsigned long)base + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1));
+        head = ptr - base;
+        if (head > 0)
+            munmap(base, head);
+        if (HUGE_PAGE - head > 0)
+            munmap(ptr + size, HUGE_PAGE - head);
+
+        buf->ptr = buf->base = ptr;
+        buf->size = size;
+        buf->mapped = 1;
+#ifdef MADV_HUGEPAGE
+        if (madvise(ptr, size, MADV_HUGEPAGE) != 0)
+#endif
+            printf("Warning: huge pages are not available, using normal pages\n");
+        return 0;
+    }
+
+    /* interleaved: the policy is set on the range before the first touch */
+    buf->base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf->base == MAP_FAILED) {
+        buf->base = NULL;
+        return -1;
+    }
+    buf->ptr = buf->base;
+    buf->size = size;
+    buf->mapped = 1;
+    {
+        unsigned long mask[MAX_NODES / BITS];
+        int nodes = online_nodes(mask);
+
+        if (nodes == 0 || syscall(SYS_mbind, buf->ptr, size, MPOL_INTERLEAVE, mask, nodes + 1, 0) != 0)
+            printf("Warning: can't interleave the pages on the NUMA nodes, using first touch\n");
+    }
+    return 0;
+}
+
+void free_buffer(struct buffer *buf)
+{
+    if (buf->base == NULL)
+        return;
+    if (buf->mapped)
+        munmap(buf->base, buf->size);
+    else
+        free(buf->base);
+    memset(buf, 0, sizeof(*buf));
+}
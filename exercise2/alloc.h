@@ -0,0 +1,53 @@
+/*
+ * Allocation of the matrices: aligned, interleaved on the NUMA nodes or
+ * backed by huge pages. The pages are not touched, so they are placed by
+ * the (parallel) initialization.
+ */
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+/*
+ * ALLOC_FIRST_TOUCH : default policy, a page is placed on the node of the thread that touches it first
+ * ALLOC_INTERLEAVE  : pages interleaved round robin on all the NUMA nodes (mbind)
+ * ALLOC_HUGE        : 2 MB aligned, transparent huge pages requested (madvise)
+ */
+enum alloc_policy { ALLOC_FIRST_TOUCH, ALLOC_INTERLEAVE, ALLOC_HUGE };
+
+/*
+ * ptr    : start of the buffer
+ * base   : start of the allocation (to release it)
+ * size   : size of the allocation in bytes
+ * mapped : 1 if allocated with mmap, 0 with malloc/posix_memalign
+ */
+struct buffer
+{
+    void *ptr;
+    void *base;
+    size_t size;
+    int mapped;
+};
+
+/*
+ * Parse the name of a policy (first, interleave, huge).
+ * Returns 0 on success, -1 if the name is unknown.
+ */
+int parse_policy(const char *name, enum alloc_policy *policy);
+
+/*
+ * Allocate a buffer of the given size. alignment (a power of two, 0 for the
+ * default of malloc) applies to the first touch policy, the other ones are
+ * page (interleave) or huge page (huge) aligned. If the policy can't be
+ * applied a message is printed and the buffer is still usable.
+ * Returns 0 on success, -1 if the memory can't be allocated.
+ */
+int alloc_buffer(struct buffer *buf, size_t size, enum alloc_policy policy, size_t alignment);
+
+/*
+ * Release a buffer allocated with alloc_buffer (nothing for an empty one).
+ */
+void free_buffer(struct buffer *buf);
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * BLAS backends loaded at run time with dlopen.
+ */
+
+#include <dlfcn.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend.h"
+#include "native.h"
+
+/*
+ * default shared libraries of each backend, tried in order
+ */
+static const char *mkl_libs[] = { "libmkl_rt.so", "libmkl_rt.so.2", "libmkl_rt.so.1", NULL };
+static const char *oblas_libs[] = { "libopenblas.so", "libopenblas.so.0", NULL };
+static const char *blis_libs[] = { "libblis.so", "libblis.so.4", "libblis.so.3", NULL };
+
+/*
+ * Reference backend: plain loops (column by column, parallel over the
+ * columns of C), used as a correctness and performance baseline.
+ */
+static void ref_sgemm(int layout, int transa, int transb, int m, int n, int k,
+                      float alpha, const float *A, int lda, const float *B, int ldb,
+                      float beta, float *C, int ldc)
+{
+    int i, j, p;
+    (void)layout; (void)transa; (void)transb;
+
+    #pragma omp parallel for private(i, p) schedule(static)
+    for (j = 0; j < n; j++) {
+        for (i = 0; i < m; i++)
+            C[i + (size_t)j*ldc] = (beta == 0.0f) ? 0.0f : beta * C[i + (size_t)j*ldc];
+        for (p = 0; p < k; p++) {
+            float b = alpha * B[p + (size_t)j*ldb];
+            for (i = 0; i < m; i++)
+                C[i + (size_t)j*ldc] += A[i + (size_t)p*lda] * b;
+        }
+    }
+}
+
+static void ref_dgemm(int layout, int transa, int transb, int m, int n, int k,
+                      double alpha, const double *A, int lda, const double *B, int ldb,
+                      double beta, double *C, int ldc)
+{
+    int i, j, p;
+    (void)layout; (void)transa; (void)transb;
+
+    #pragma omp parallel for private(i, p) schedule(static)
+    for (j = 0; j < n; j++) {
+        for (i = 0; i < m; i++)
+            C[i + (size_t)j*ldc] = (beta == 0.0) ? 0.0 : beta * C[i + (size_t)j*ldc];
+        for (p = 0; p < k; p++) {
+            double b = alpha * B[p + (size_t)j*ldb];
+            for (i = 0; i < m; i++)
+                C[i + (size_t)j*ldc] += A[i + (size_t)p*lda] * b;
+        }
+    }
+}
+
+int backend_load(struct backend *b, const char *name, const char *path)
+{
+    const char **libs;
+    const char *single[2] = { path, NULL };
+    int i;
+
+    memset(b, 0, sizeof(*b));
+    /* copies: name and path may point into a buffer of the caller */
+    b->name = strdup(name);
+    b->path = (path != NULL) ? strdup(path) : NULL;
+
+    if (strcmp(name, "ref") == 0) {
+        b->sgemm = ref_sgemm;
+        b->dgemm = ref_dgemm;
+        return 0;
+    }
+
+    if (strcmp(name, "native") == 0) {
+        b->sgemm = native_sgemm;
+        b->dgemm = native_dgemm;
+        return 0;
+    }
+
+    if (strcmp(name, "mkl") == 0) {
+        /* libmkl_rt chooses the threading layer at run time: use the GNU OpenMP one */
+        setenv("MKL_THREADING_LAYER", "GNU", 0);
+        setenv("MKL_INTERFACE_LAYER", "LP64", 0);
+        libs = mkl_libs;
+    } else if (strcmp(name, "oblas") == 0) {
+        libs = oblas_libs;
+    } else if (strcmp(name, "blis") == 0) {
+        libs = blis_libs;
+    } else {
+        printf("\n ERROR: unknown backend %s (mkl, oblas, blis, native, ref)\n\n", name);
+        backend_close(b);
+        return -1;
+    }
+    if (path != NULL)
+        libs = single;
+
+    /* RTLD_LOCAL: the symbols of different libraries do not clash */
+    for (i = 0; libs[i] != NULL && b->handle == NULL; i++)
+        b->handle = dlopen(libs[i], RTLD_NOW | RTLD_LOCAL);
+
+    if (b->handle == NULL) {
+        printf("\n ERROR: can't load backend %s: %s\n\n", name, dlerror());
+        backend_close(b);
+        return -1;
+    }
+
+    b->sgemm = (sgemm_fn)dlsym(b->handle, "cblas_sgemm");
+    b->dgemm = (dgemm_fn)dlsym(b->handle, "cblas_dgemm");
+    if (b->sgemm == NULL || b->dgemm == NULL) {
+        printf("\n ERROR: backend %s does not provide cblas_sgemm/cblas_dgemm\n\n", name);
+        backend_close(b);
+        return -1;
+    }
+
+    /* the libraries not built on the OpenMP runtime have their own setter */
+    b->set_threads = (void (*)(int))dlsym(b->handle, "MKL_Set_Num_Threads");
+    if (b->set_threads == NULL)
+        b->set_threads = (void (*)(int))dlsym(b->handle, "openblas_set_num_threads");
+    b->set_threads_dim = (void (*)(long))dlsym(b->handle, "bli_thread_set_num_threads");
+
+    /* batched APIs (MKL, recent OpenBLAS) */
+    b->sgemm_batch = (sgemm_batch_fn)dlsym(b->handle, "cblas_sgemm_batch");
+    b->dgemm_batch = (dgemm_batch_fn)dlsym(b->handle, "cblas_dgemm_batch");
+    b->sgemm_batch_strided = (sgemm_batch_strided_fn)dlsym(b->handle, "cblas_sgemm_batch_strided");
+    b->dgemm_batch_strided = (dgemm_batch_strided_fn)dlsym(b->handle, "cblas_dgemm_batch_strided");
+
+    /* 16 bit inputs with fp32 accumulation (MKL) */
+    b->gemm_bf16 = (gemm_16_fn)dlsym(b->handle, "cblas_gemm_bf16bf16f32");
+    b->gemm_f16 = (gemm_16_fn)dlsym(b->handle, "cblas_gemm_f16f16f32");
+
+    return 0;
+}
+
+void backend_set_threads(struct backend *b, int threads)
+{
+    omp_set_num_threads(threads);
+    backend_set_library_threads(b, threads);
+}
+
+void backend_set_library_threads(struct backend *b, int threads)
+{
+    if (b->set_threads != NULL)
+        b->set_threads(threads);
+    if (b->set_threads_dim != NULL)
+        b->set_threads_dim(threads);
+}
+
+void backend_close(struct backend *b)
+{
+    if (b->handle != NULL)
+        dlclose(b->handle);
+    b->handle = NULL;
+    free(b->name);
+    free(b->path);
+    b->name = NULL;
+    b->path = NULL;
+}
+
+void backend_gemm(struct backend *b, enum precision prec, int m, int n, int k,
+                  double alpha, const void *A, int lda, const void *B, int ldb,
+                  double beta, void *C, int ldc)
+{
+    if (prec == PREC_FLOAT)
+        b->sgemm(CBLAS_COL_MAJOR, CBLAS_NO_TRANS, CBLAS_NO_TRANS, m, n, k,
+                 (float)alpha, (const float *)A, lda, (const float *)B, ldb,
+                 (float)beta, (float *)C, ldc);
+    else
+        b->dgemm(CBLAS_COL_MAJOR, CBLAS_NO_TRANS, CBLAS_NO_TRANS, m, n, k,
+                 alpha, (const double *)A, lda, (const double *)B, ldb,
+                 beta, (double *)C, ldc);
+}
+
+/*
+ * Call the batched API of the backend for the batch.
+ * Returns 1 if the API is available, 0 otherwise.
+ */
+static int gemm_batch_api(struct backend *b, enum precision prec, int m, int n, int k,
+                          double alpha, double beta, const struct batch *bt)
+{
+    int trans = CBLAS_NO_TRANS;
+    float salpha = (float)alpha, sbeta = (float)beta;
+
+    if (bt->layout == BATCH_STRIDED) {
+        if (prec == PREC_FLOAT && b->sgemm_batch_strided != NULL)
+            b->sgemm_batch_strided(CBLAS_COL_MAJOR, trans, trans, m, n, k,
+                                   salpha, (const float *)bt->A, m, bt->stride_a,
+                                   (const float *)bt->B, k, bt->stride_b,
+                                   sbeta, (float *)bt->C, m, bt->stride_c, bt->count);
+        else if (prec == PREC_DOUBLE && b->dgemm_batch_strided != NULL)
+            b->dgemm_batch_strided(CBLAS_COL_MAJOR, trans, trans, m, n, k,
+                                   alpha, (const double *)bt->A, m, bt->stride_a,
+                                   (const double *)bt->B, k, bt->stride_b,
+                                   beta, (double *)bt->C, m, bt->stride_c, bt->count);
+        else
+            return 0;
+        return 1;
+    }
+
+    /* a single group with all the multiplications */
+    if (prec == PREC_FLOAT && b->sgemm_batch != NULL)
+        b->sgemm_batch(CBLAS_COL_MAJOR, &trans, &trans, &m, &n, &k, &salpha,
+                       (const float **)bt->a, &m, (const float **)bt->b, &k,
+                       &sbeta, (float **)bt->c, &m, 1, &bt->count);
+    else if (prec == PREC_DOUBLE && b->dgemm_batch != NULL)
+        b->dgemm_batch(CBLAS_COL_MAJOR, &trans, &trans, &m, &n, &k, &alpha,
+                       (const double **)bt->a, &m, (const double **)bt->b, &k,
+                       &beta, (double **)bt->c, &m, 1, &bt->count);
+    else
+        return 0;
+    return 1;
+}
+
+int backend_gemm_batch(struct backend *b, enum precision prec, int m, int n, int k,
+                       double alpha, double beta, const struct batch *bt, int loop)
+{
+    size_t size = precision_size(prec);
+    int i, threads = omp_get_max_threads(), levels = omp_get_max_active_levels();
+
+    if (!loop && gemm_batch_api(b, prec, m, n, k, alpha, beta, bt))
+        return 1;
+
+    /* one multiplication per thread: the library runs single threaded and the
+       calls of the in-tree backends are not parallel (nested region) */
+    backend_set_library_threads(b, 1);
+    omp_set_max_active_levels(1);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (i = 0; i < bt->count; i++) {
+        if (bt->layout == BATCH_ARRAY)
+            backend_gemm(b, prec, m, n, k, alpha, bt->a[i], m, bt->b[i], k, beta, bt->c[i], m);
+        else
+            backend_gemm(b, prec, m, n, k, alpha,
+                         (const char *)bt->A + (size_t)i * bt->stride_a * size, m,
+                         (const char *)bt->B + (size_t)i * bt->stride_b * size, k, beta,
+                         (char *)bt->C + (size_t)i * bt->stride_c * size, m);
+    }
+
+    omp_set_max_active_levels(levels);
+    backend_set_library_threads(b, threads);
+    return 0;
+}
+
+size_t precision_size(enum precision prec)
+{
+    return (prec == PREC_FLOAT) ? sizeof(float) : sizeof(double);
+}
+
+const char *precision_name(enum precision prec)
+{
+    return (prec == PREC_FLOAT) ? "float" : "double";
+}
@@ -0,0 +1,151 @@
+/*
+ * BLAS backends loaded at run time with dlopen, so a single gemm.x can
+ * compare MKL, OpenBLAS, BLIS and the in-tree implementations on the same
+ * buffers within the same process.
+ */
+
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <stddef.h>
+
+/* values of the CBLAS enums (the same for all the implementations) */
+#define CBLAS_COL_MAJOR 102
+#define CBLAS_NO_TRANS 111
+
+enum precision { PREC_FLOAT, PREC_DOUBLE };
+
+typedef void (*sgemm_fn)(int layout, int transa, int transb, int m, int n, int k,
+                         float alpha, const float *A, int lda, const float *B, int ldb,
+                         float beta, float *C, int ldc);
+typedef void (*dgemm_fn)(int layout, int transa, int transb, int m, int n, int k,
+                         double alpha, const double *A, int lda, const double *B, int ldb,
+                         double beta, double *C, int ldc);
+
+/* group API of MKL (cblas_?gemm_batch) and strided API (cblas_?gemm_batch_strided) */
+typedef void (*sgemm_batch_fn)(int layout, const int *transa, const int *transb,
+                               const int *m, const int *n, const int *k, const float *alpha,
+                               const float **A, const int *lda, const float **B, const int *ldb,
+                               const float *beta, float **C, const int *ldc,
+                               int group_count, const int *group_size);
+typedef void (*dgemm_batch_fn)(int layout, const int *transa, const int *transb,
+                               const int *m, const int *n, const int *k, const double *alpha,
+                               const double **A, const int *lda, const double **B, const int *ldb,
+                               const double *beta, double **C, const int *ldc,
+                               int group_count, const int *group_size);
+typedef void (*sgemm_batch_strided_fn)(int layout, int transa, int transb, int m, int n, int k,
+                                       float alpha, const float *A, int lda, int stridea,
+                                       const float *B, int ldb, int strideb,
+                                       float beta, float *C, int ldc, int stridec, int batch_size);
+typedef void (*dgemm_batch_strided_fn)(int layout, int transa, int transb, int m, int n, int k,
+                                       double alpha, const double *A, int lda, int stridea,
+                                       const double *B, int ldb, int strideb,
+                                       double beta, double *C, int ldc, int stridec, int batch_size);
+
+/* 16 bit inputs with fp32 accumulation of MKL (cblas_gemm_bf16bf16f32, cblas_gemm_f16f16f32) */
+typedef void (*gemm_16_fn)(int layout, int transa, int transb, int m, int n, int k,
+                           float alpha, const unsigned short *A, int lda,
+                           const unsigned short *B, int ldb, float beta, float *C, int ldc);
+
+/*
+ * name   : short name of the backend (mkl, oblas, blis, native, ref), owned copy
+ * path   : shared library given on the command line (NULL for the default ones), owned copy
+ * handle : handle returned by dlopen (NULL for the in-tree backends)
+ * sgemm  : cblas_sgemm of the backend
+ * dgemm  : cblas_dgemm of the backend
+ * set_threads     : thread setter of MKL/OpenBLAS (NULL if not available)
+ * set_threads_dim : thread setter of BLIS, that takes a dim_t (NULL if not available)
+ * sgemm_batch, dgemm_batch, sgemm_batch_strided, dgemm_batch_strided :
+ *          batched APIs of the backend (NULL if not available)
+ * gemm_bf16, gemm_f16 : bf16/fp16 inputs with fp32 accumulation (NULL if not available)
+ */
+struct backend
+{
+    char *name;
+    char *path;
+    void *handle;
+    sgemm_fn sgemm;
+    dgemm_fn dgemm;
+    void (*set_threads)(int);
+    void (*set_threads_dim)(long);
+    sgemm_batch_fn sgemm_batch;
+    dgemm_batch_fn dgemm_batch;
+    sgemm_batch_strided_fn sgemm_batch_strided;
+    dgemm_batch_strided_fn dgemm_batch_strided;
+    gemm_16_fn gemm_bf16;
+    gemm_16_fn gemm_f16;
+};
+
+enum batch_layout { BATCH_ARRAY, BATCH_STRIDED };
+
+/*
+ * Batch of independent multiplications of the same shape.
+ * layout   : pointer arrays or constant strides
+ * count    : number of multiplications
+ * a, b, c  : pointer arrays to the matrices (BATCH_ARRAY)
+ * A, B, C  : first matrices (BATCH_STRIDED)
+ * stride_a, stride_b, stride_c : elements between two matrices (BATCH_STRIDED)
+ */
+struct batch
+{
+    enum batch_layout layout;
+    int count;
+    const void **a, **b;
+    void **c;
+    const void *A, *B;
+    void *C;
+    int stride_a, stride_b, stride_c;
+};
+
+/*
+ * Load the backend with the given name. If path is not NULL it is the shared
+ * library to open, otherwise the default names of the backend are tried
+ * (found through LD_LIBRARY_PATH, e.g. after a module load).
+ * Returns 0 on success, -1 (with a message) otherwise.
+ */
+int backend_load(struct backend *b, const char *name, const char *path);
+
+/*
+ * Close the shared library of the backend and free its name and path.
+ */
+void backend_close(struct backend *b);
+
+/*
+ * Set the number of threads used by the backend (OpenMP and the library
+ * specific setting).
+ */
+void backend_set_threads(struct backend *b, int threads);
+
+/*
+ * Set only the library specific number of threads (not OpenMP).
+ */
+void backend_set_library_threads(struct backend *b, int threads);
+
+/*
+ * C = alpha * A * B + beta * C with column major, non transposed matrices
+ * A(m,k) B(k,n) C(m,n), with the given precision.
+ */
+void backend_gemm(struct backend *b, enum precision prec, int m, int n, int k,
+                  double alpha, const void *A, int lda, const void *B, int ldb,
+                  double beta, void *C, int ldc);
+
+/*
+ * Run a batch of multiplications C(m,n) = alpha * A(m,k) * B(k,n) + beta * C(m,n)
+ * with the batched API of the backend or, if not available or if loop is set,
+ * with an OpenMP loop over the batch of single threaded calls.
+ * Returns 1 if the batched API was used, 0 for the loop.
+ */
+int backend_gemm_batch(struct backend *b, enum precision prec, int m, int n, int k,
+                       double alpha, double beta, const struct batch *bt, int loop);
+
+/*
+ * Returns the size in bytes of an element of the given precision.
+ */
+size_t precision_size(enum precision prec);
+
+/*
+ * Returns the name of the precision as written in the CSV (float, double).
+ */
+const char *precision_name(enum precision prec);
+
+#endif
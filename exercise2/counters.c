@@ -0,0 +1,315 @@
+/*
+ * Hardware performance counters with perf_event_open (no libpfm/PAPI).
+ */
+
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "counters.h"
+
+/* raw FP events: event | umask << 8 */
+#define INTEL_FP_EVENT 0xc7     /* FP_ARITH_INST_RETIRED, umasks by vector width below */
+#define AMD_FP_EVENT 0xff03     /* FpRetSseAvxOps: all FLOPs */
+
+/* most FP events of a CPU */
+#define MAX_FP_EVENTS 8
+
+/* PMUs of sysfs, the uncore IMC ones are uncore_imc or uncore_imc_<n> */
+#define EVENT_SOURCE "/sys/bus/event_source/devices"
+#define IMC_PMU "uncore_imc"
+
+/* CAS events of the IMC: server (cas_count_*) and client (data_*) parts */
+static const char *imc_events[] = { "cas_count_read", "cas_count_write", "data_reads", "data_writes" };
+
+/*
+ * umasks of FP_ARITH_INST_RETIRED grouped by elements per instruction: scalar
+ * (single and double), 128 bit double, 128 bit single and 256 bit double,
+ * 256 bit single and 512 bit double, 512 bit single. An FMA counts twice.
+ */
+static const unsigned intel_fp_umasks[] = { 0x03, 0x04, 0x18, 0x60, 0x80 };
+static const double intel_fp_weights[] = { 1.0, 2.0, 4.0, 8.0, 16.0 };
+
+/*
+ * Set the raw FP events of this CPU and the FLOPs of each count.
+ * Returns the number of events, 0 if the CPU is unknown.
+ */
+static int fp_events(uint64_t *raw, double *weight)
+{
+    char line[256];
+    int i, count = 0;
+    const char *env = getenv("GEMM_FP_EVENT");
+    FILE *fp;
+
+    if (env != NULL) {
+        raw[0] = strtoull(env, NULL, 0);
+        weight[0] = 1.0;
+        return 1;
+    }
+
+    if ((fp = fopen("/proc/cpuinfo", "r")) == NULL)
+        return 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, "vendor_id", 9) == 0) {
+            if (strstr(line, "GenuineIntel") != NULL) {
+                for (i = 0; i < (int)(sizeof(intel_fp_umasks) / sizeof(intel_fp_umasks[0])); i++) {
+                    raw[i] = INTEL_FP_EVENT | (uint64_t)intel_fp_umasks[i] << 8;
+                    weight[i] = intel_fp_weights[i];
+                }
+                count = i;
+            } else if (strstr(line, "AuthenticAMD") != NULL) {
+                raw[0] = AMD_FP_EVENT;
+                weight[0] = 1.0;
+                count = 1;
+            }
+            break;
+        }
+    }
+    fclose(fp);
+    return count;
+}
+
+/*
+ * Read the first line of a file of sysfs. Returns 0 on success, -1 otherwise.
+ */
+static int read_sysfs(const char *path, char *buf, size_t size)
+{
+    FILE *fp = fopen(path, "r");
+    int ok;
+
+    if (fp == NULL)
+        return -1;
+    ok = (fgets(buf, (int)size, fp) != NULL);
+    fclose(fp);
+    if (!ok)
+        return -1;
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+/*
+ * Encode the event of a PMU of sysfs ("event=0x04,umask=0x03") in config with
+ * the bit ranges of its format directory ("config:0-7").
+ * Returns 0 on success, -1 if a term is unknown or not in config.
+ */
+static int event_config(const char *pmu, const char *event, uint64_t *config)
+{
+    char path[512], desc[256], format[64], *term, *save;
+    unsigned lo, hi;
+    uint64_t value;
+
+    snprintf(path, sizeof(path), "%s/%s/events/%s", EVENT_SOURCE, pmu, event);
+    if (read_sysfs(path, desc, sizeof(desc)) != 0)
+        return -1;
+
+    *config = 0;
+    for (term = strtok_r(desc, ",", &save); term != NULL; term = strtok_r(NULL, ",", &save)) {
+        char *eq = strchr(term, '=');
+
+        value = (eq != NULL) ? strtoull(eq + 1, NULL, 0) : 1;
+        if (eq != NULL)
+            *eq = '\0';
+        snprintf(path, sizeof(path), "%s/%s/format/%s", EVENT_SOURCE, pmu, term);
+        if (read_sysfs(path, format, sizeof(format)) != 0)
+            return -1;
+        if (sscanf(format, "config:%u-%u", &lo, &hi) != 2) {
+            if (sscanf(format, "config:%u", &lo) != 1)
+                return -1;
+            hi = lo;
+        }
+        if (hi >= 64 || lo > hi)
+            return -1;
+        if (hi - lo < 63)
+            value &= ((uint64_t)1 << (hi - lo + 1)) - 1;
+        *config |= value << lo;
+    }
+    return 0;
+}
+
+/*
+ * Open a counter of a thread, disabled and counting only user space.
+ */
+static int open_counter(int id, pid_t tid, uint64_t raw)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (id) {
+    case CNT_CYCLES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case CNT_INSTRUCTIONS:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case CNT_FP_OPS:
+        if (raw == 0)
+            return -1;
+        attr.type = PERF_TYPE_RAW;
+        attr.config = raw;
+        break;
+    case CNT_LLC_MISSES:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    }
+
+    return (int)syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+}
+
+/*
+ * Add an open counter (nothing if fd is an error).
+ */
+static void add_counter(struct counters *c, int fd, int id, double weight)
+{
+    if (fd < 0)
+        return;
+    c->fds = (int *)realloc(c->fds, (c->nfds + 1) * sizeof(int));
+    c->ids = (int *)realloc(c->ids, (c->nfds + 1) * sizeof(int));
+    c->weights = (double *)realloc(c->weights, (c->nfds + 1) * sizeof(double));
+    c->fds[c->nfds] = fd;
+    c->ids[c->nfds] = id;
+    c->weights[c->nfds] = weight;
+    c->nfds++;
+    c->available[id] = 1;
+}
+
+/*
+ * Open the CAS events of every uncore IMC PMU on the CPUs of its cpumask (one
+ * per socket). The uncore events count for the whole socket, not per task.
+ */
+static void open_uncore(struct counters *c)
+{
+    char path[512], buf[256], *cpu, *save;
+    struct perf_event_attr attr;
+    struct dirent *entry;
+    uint64_t config;
+    size_t e;
+    int type;
+    DIR *dir;
+
+    if ((dir = opendir(EVENT_SOURCE)) == NULL)
+        return;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, IMC_PMU, strlen(IMC_PMU)) != 0)
+            continue;
+        snprintf(path, sizeof(path), "%s/%s/type", EVENT_SOURCE, entry->d_name);
+        if (read_sysfs(path, buf, sizeof(buf)) != 0)
+            continue;
+        type = atoi(buf);
+
+        for (e = 0; e < sizeof(imc_events) / sizeof(imc_events[0]); e++) {
+            if (event_config(entry->d_name, imc_events[e], &config) != 0)
+                continue;
+            snprintf(path, sizeof(path), "%s/%s/cpumask", EVENT_SOURCE, entry->d_name);
+            if (read_sysfs(path, buf, sizeof(buf)) != 0)
+                continue;
+
+            /* uncore PMUs support no user/kernel filtering */
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            for (cpu = strtok_r(buf, ",", &save); cpu != NULL; cpu = strtok_r(NULL, ",", &save))
+                add_counter(c, (int)syscall(SYS_perf_event_open, &attr, -1, atoi(cpu), -1, 0),
+                            CNT_DRAM_LINES, 1.0);
+        }
+    }
+    closedir(dir);
+}
+
+int counters_start(struct counters *c)
+{
+    uint64_t raw[MAX_FP_EVENTS];
+    double weight[MAX_FP_EVENTS];
+    int nfp = fp_events(raw, weight);
+    struct dirent *entry;
+    int i, e, count = 0;
+    DIR *dir;
+
+    memset(c, 0, sizeof(*c));
+
+    if ((dir = opendir("/proc/self/task")) == NULL)
+        return 0;
+    while ((entry = readdir(dir)) != NULL) {
+        pid_t tid = (pid_t)atoi(entry->d_name);
+        if (tid <= 0)
+            continue;
+        for (i = 0; i < NCOUNTERS; i++) {
+            if (i == CNT_DRAM_LINES)
+                continue;
+            if (i != CNT_FP_OPS) {
+                add_counter(c, open_counter(i, tid, 0), i, 1.0);
+                continue;
+            }
+            for (e = 0; e < nfp; e++)
+                add_counter(c, open_counter(i, tid, raw[e]), i, weight[e]);
+        }
+    }
+    closedir(dir);
+
+    open_uncore(c);
+
+    for (i = 0; i < NCOUNTERS; i++)
+        count += c->available[i];
+
+    for (i = 0; i < c->nfds; i++) {
+        ioctl(c->fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(c->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+    return count;
+}
+
+void counters_stop(struct counters *c)
+{
+    /* value, time enabled, time running */
+    uint64_t data[3];
+    int i;
+
+    for (i = 0; i < c->nfds; i++)
+        ioctl(c->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    for (i = 0; i < c->nfds; i++) {
+        if (read(c->fds[i], data, sizeof(data)) == sizeof(data) && data[2] > 0)
+            c->values[c->ids[i]] += c->weights[i] * (double)data[0] * ((double)data[1] / (double)data[2]);
+        close(c->fds[i]);
+    }
+
+    free(c->fds);
+    free(c->ids);
+    free(c->weights);
+    c->fds = NULL;
+    c->ids = NULL;
+    c->weights = NULL;
+    c->nfds = 0;
+}
+
+double counters_traffic(const struct counters *c, const char **source)
+{
+    if (c->available[CNT_DRAM_LINES]) {
+        *source = "imc";
+        return c->values[CNT_DRAM_LINES] * CACHE_LINE;
+    }
+    if (c->available[CNT_LLC_MISSES]) {
+        *source = "llc";
+        return c->values[CNT_LLC_MISSES] * CACHE_LINE;
+    }
+    *source = NULL;
+    return 0.0;
+}
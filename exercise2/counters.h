@@ -0,0 +1,64 @@
+/*
+ * Hardware performance counters (perf_event_open) of all the threads of the
+ * process, read around the timed GEMM calls.
+ */
+
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+/* size of a cache line and of a DRAM transfer (CAS) */
+#define CACHE_LINE 64
+
+/*
+ * CNT_FP_OPS     : FLOPs (weighted sum of the FP events)
+ * CNT_LLC_MISSES : LLC demand (load) misses, the lines brought by the
+ *                  prefetchers are not counted
+ * CNT_DRAM_LINES : lines read and written at the memory controllers
+ *                  (uncore IMC, system wide: all the processes and sockets)
+ */
+enum counter { CNT_CYCLES, CNT_INSTRUCTIONS, CNT_FP_OPS, CNT_LLC_MISSES, CNT_DRAM_LINES, NCOUNTERS };
+
+/*
+ * fds       : file descriptors of the events (of each thread, or of each
+ *             socket for the uncore events)
+ * ids       : counter of each file descriptor
+ * weights   : weight of each file descriptor in the sum of its counter
+ * nfds      : number of open file descriptors
+ * values    : sum over the threads of each counter (scaled if multiplexed)
+ * available : 1 if the counter could be opened for at least one thread
+ */
+struct counters
+{
+    int *fds;
+    int *ids;
+    double *weights;
+    int nfds;
+    double values[NCOUNTERS];
+    int available[NCOUNTERS];
+};
+
+/*
+ * Open the counters on all the threads of the process (/proc/self/task) and
+ * start them. The threads must already exist (e.g. after a warm-up call).
+ * The FP events are raw and model specific: FP_ARITH_INST_RETIRED on Intel
+ * (one event per vector width, weighted by its elements), FpRetSseAvxOps on
+ * AMD, GEMM_FP_EVENT in the environment overrides them (counted as is). The
+ * DRAM lines are the CAS events of the uncore_imc PMUs of sysfs (Intel, they
+ * need perf_event_paranoid <= 0), AMD exposes no such event.
+ * Returns the number of available counters (0 if perf events can't be used).
+ */
+int counters_start(struct counters *c);
+
+/*
+ * Stop the counters, sum them over the threads and close them.
+ */
+void counters_stop(struct counters *c);
+
+/*
+ * Returns the memory traffic in bytes of the stopped counters and sets source
+ * to its origin: "imc" (measured at the memory controllers), "llc" (estimate
+ * from the LLC demand misses, a lower bound) or NULL (0 bytes, unavailable).
+ */
+double counters_traffic(const struct counters *c, const char **source);
+
+#endif
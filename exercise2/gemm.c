@@ -9,33 +9,49 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <omp.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
-#ifdef MKL 
-#include "mkl_cblas.h"
-#endif
+#include "backend.h"
+#include "native.h"
+#include "tune.h"
+#include "alloc.h"
+#include "counters.h"
+#include "mixed.h"
+#include "verify.h"
 
-#ifdef OPENBLAS
-#include "cblas.h"
-#endif
+/* default number of untimed and measured repetitions of each shape */
+#define WARMUP 1
+#define REPS 10
 
-#ifdef BLIS
-#include "cblas.h"
-#endif
+/* the benchmark itself, restarted by the autotuner and to apply the tuned places/bind */
+#define SELF "/proc/self/exe"
 
-#include <time.h>
-#include <unistd.h>
+/* default backends (comma separated) */
+#define BACKENDS "oblas"
 
-#ifdef USE_FLOAT
-#define MYFLOAT float
-#define DATATYPE printf("float, ");
-#define GEMMCPU cblas_sgemm
-#endif
+/* time is the median of the measured repetitions, gflop is computed from it */
+#define CSV_HEADER "type, size, time, gflop, m, k, n, warmup, reps, time_min, time_mean, time_stddev, gflop_max, backend"
 
-#ifdef USE_DOUBLE
-#define MYFLOAT double 
-#define DATATYPE printf("double, ");
-#define GEMMCPU cblas_dgemm
-#endif
+/* columns added by the roofline: intensity used, attainable GFLOP/s and percentage of it */
+#define CSV_ROOFLINE ", ai, attainable, roofline_pct"
+
+/* columns added by the batch mode: multiplications, layout and batched API (batch) or OpenMP loop (loop) */
+#define CSV_BATCH ", batch, layout, api"
+
+/* columns added by the hardware counters (per call, summed over the threads), traffic is the
+   origin of the bytes of bandwidth and intensity: imc (measured) or llc (demand miss estimate) */
+#define CSV_COUNTERS ", cycles, instructions, fp_ops, llc_misses, dram_lines, ipc, traffic, bandwidth, intensity"
+
+/* column added by the reduced and mixed precision modes: max error relative to the double reference */
+#define CSV_ERROR ", error"
+
+/* columns added by the verification: Freivalds residual, tolerance and ok/FAIL */
+#define CSV_VERIFY ", residual, tolerance, verified"
 
 struct timespec diff(struct timespec start, struct timespec end)
 {
@@ -49,70 +65,786 @@ struct timespec diff(struct timespec start, struct timespec end)
         }
         return temp;
 }
+/*
+ * shape of a multiplication: A(M,K) B(K,N) C(M,N)
+ */
+struct shape
+{
+    int m, k, n;
+};
+
+/*
+ * statistics of the measured repetitions of a shape (times in seconds)
+ */
+struct measure
+{
+    double min, median, mean, stddev;
+};
+
+int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Add a shape to the list, growing it if needed.
+ */
+void add_shape(struct shape **shapes, int *nshapes, int *capacity, int m, int k, int n)
+{
+    if (*nshapes == *capacity) {
+        *capacity = (*capacity == 0) ? 16 : 2 * (*capacity);
+        *shapes = (struct shape *)realloc(*shapes, *capacity * sizeof(struct shape));
+    }
+    (*shapes)[*nshapes].m = m;
+    (*shapes)[*nshapes].k = k;
+    (*shapes)[*nshapes].n = n;
+    (*nshapes)++;
+}
+
+/*
+ * Parse a comma separated list of shapes. Each item is either
+ *   S          square shape M = K = N = S
+ *   MxKxN      rectangular shape
+ *   A-B:S      square shapes from A to B (included) with step S
+ * Returns the number of shapes, 0 if the list is malformed.
+ */
+int parse_shapes(char *list, struct shape **shapes, int *nshapes, int *capacity)
+{
+    char *copy = strdup(list);
+    char *item, *save;
+    int m, k, n, first, last, step;
+
+    for (item = strtok_r(copy, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+        if (sscanf(item, "%d-%d:%d", &first, &last, &step) == 3 && step > 0) {
+            for (m = first; m <= last; m += step)
+                add_shape(shapes, nshapes, capacity, m, m, m);
+        } else if (sscanf(item, "%dx%dx%d", &m, &k, &n) == 3) {
+            add_shape(shapes, nshapes, capacity, m, k, n);
+        } else if (sscanf(item, "%d", &m) == 1) {
+            add_shape(shapes, nshapes, capacity, m, m, m);
+        } else {
+            free(copy);
+            return 0;
+        }
+    }
+    free(copy);
+    return *nshapes;
+}
+
+/*
+ * Given the times of the repetitions compute min, median, mean and standard deviation.
+ */
+struct measure compute_measure(double *times, int reps)
+{
+    struct measure res;
+    double sum = 0.0, sq = 0.0;
+    int r;
+
+    qsort(times, reps, sizeof(double), compare_double);
+    res.min = times[0];
+    res.median = (reps % 2) ? times[reps / 2] : 0.5 * (times[reps / 2 - 1] + times[reps / 2]);
+    for (r = 0; r < reps; r++)
+        sum += times[r];
+    res.mean = sum / reps;
+    for (r = 0; r < reps; r++)
+        sq += (times[r] - res.mean) * (times[r] - res.mean);
+    res.stddev = (reps > 1) ? sqrt(sq / (reps - 1)) : 0.0;
+    return res;
+}
+
+/*
+ * Returns 1 if the CSV file does not exist, is empty or starts with the
+ * given header, 0 otherwise.
+ */
+int same_header(const char *file, const char *header)
+{
+    char line[1024];
+    int same = 1;
+    FILE *fp = fopen(file, "r");
+
+    if (fp == NULL)
+        return 1;
+    if (fgets(line, sizeof(line), fp) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        same = (strcmp(line, header) == 0);
+    }
+    fclose(fp);
+    return same;
+}
+
+/*
+ * Parse a comma separated list of backends, each item is name[=library].
+ * Returns the number of loaded backends, 0 if one of them can't be loaded.
+ */
+int load_backends(char *list, struct backend **backends)
+{
+    char *copy = strdup(list);
+    char *item, *save, *path;
+    int count = 0;
+
+    for (item = strtok_r(copy, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+        path = strchr(item, '=');
+        if (path != NULL)
+            *path++ = '\0';
+        *backends = (struct backend *)realloc(*backends, (count + 1) * sizeof(struct backend));
+        if (backend_load(&(*backends)[count], item, path) != 0) {
+            free(copy);
+            return 0;
+        }
+        count++;
+    }
+    free(copy);
+    return count;
+}
+
+/*
+ * Initialize the na, nb and nc elements of A, B and C with the given precision.
+ * The loops are split statically among the threads, bound as in the GEMM call,
+ * so the pages are first touched (and placed) on the NUMA nodes that use them.
+ */
+void init_matrices(enum precision prec, void *A, void *B, void *C, size_t na, size_t nb, size_t nc)
+{
+    long i;
+
+    #pragma omp parallel private(i)
+    {
+        if (prec == PREC_FLOAT) {
+            #pragma omp for schedule(static) nowait
+            for (i = 0; i < (long)na; i++) ((float *)A)[i] = (float)(i+1);
+            #pragma omp for schedule(static) nowait
+            for (i = 0; i < (long)nb; i++) ((float *)B)[i] = (float)(-(double)i-1);
+            #pragma omp for schedule(static) nowait
+            for (i = 0; i < (long)nc; i++) ((float *)C)[i] = 0.0f;
+        } else {
+            #pragma omp for schedule(static) nowait
+            for (i = 0; i < (long)na; i++) ((double *)A)[i] = (double)(i+1);
+            #pragma omp for schedule(static) nowait
+            for (i = 0; i < (long)nb; i++) ((double *)B)[i] = -(double)i-1;
+            #pragma omp for schedule(static) nowait
+            for (i = 0; i < (long)nc; i++) ((double *)C)[i] = 0.0;
+        }
+    }
+}
+
+/*
+ * Returns a pseudo random double in [-1,1) with all the bits of the mantissa
+ * set (the integers of init_matrices are exact in the reduced precisions).
+ */
+double uniform(unsigned long i)
+{
+    unsigned long x = (i + 1) * 0x9e3779b97f4a7c15UL;
+
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9UL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebUL;
+    x ^= x >> 31;
+    return ldexp((double)(x >> 11), -52) - 1.0;
+}
+
+/*
+ * Initialize A and B of the reduced and mixed precision modes with values
+ * in [-1,1) (in the range of fp16), first touched as in init_matrices.
+ */
+void init_uniform(double *A, double *B, double *C, size_t na, size_t nb, size_t nc)
+{
+    long i;
+
+    #pragma omp parallel private(i)
+    {
+        #pragma omp for schedule(static) nowait
+        for (i = 0; i < (long)na; i++) A[i] = uniform(i);
+        #pragma omp for schedule(static) nowait
+        for (i = 0; i < (long)nb; i++) B[i] = uniform(na + i);
+        #pragma omp for schedule(static) nowait
+        for (i = 0; i < (long)nc; i++) C[i] = 0.0;
+    }
+}
+
+/*
+ * Returns the largest difference between C and the reference, relative to
+ * the largest element of the reference.
+ */
+double max_error(const double *C, const double *ref, size_t count)
+{
+    double err = 0.0, norm = 0.0;
+    long i;
+
+    #pragma omp parallel for reduction(max:err,norm)
+    for (i = 0; i < (long)count; i++) {
+        err = fmax(err, fabs(C[i] - ref[i]));
+        norm = fmax(norm, fabs(ref[i]));
+    }
+    return (norm > 0.0) ? err / norm : err;
+}
+
+/*
+ * Returns the tolerance of the verification: rounding of the accumulation
+ * (k unit roundoffs), of the inputs of bf16/fp16 and of the long double check.
+ */
+double tolerance(enum precision prec, enum mixed_mode mode, int m, int k, int n)
+{
+    double u = (prec == PREC_FLOAT || mode == MIXED_BF16 || mode == MIXED_FP16) ? FLT_EPSILON / 2 : DBL_EPSILON / 2;
+    double in = (mode == MIXED_BF16) ? ldexp(1.0, -8) : (mode == MIXED_FP16) ? ldexp(1.0, -11) : 0.0;
+
+    return 2.0 * in + k * u + (double)(m + k + n) * LDBL_EPSILON;
+}
+
+/*
+ * Apply the tuned thread count and blocking of a backend and shape (the
+ * defaults if not tuned), unless given by OMP_NUM_THREADS and -B.
+ */
+void apply_config(const char *cache, struct backend *b, enum precision prec, int m, int k, int n,
+                  int default_threads, struct blocking default_blk, int blocking_given)
+{
+    struct tune_config cfg;
+
+    if (!tune_lookup(cache, b->name, prec, m, k, n, &cfg)) {
+        cfg.threads = default_threads;
+        cfg.blk = default_blk;
+    }
+    if (getenv("OMP_NUM_THREADS") == NULL)
+        backend_set_threads(b, cfg.threads);
+    if (!blocking_given && cfg.blk.mc > 0)
+        native_set_blocking(prec, cfg.blk);
+    else
+        native_set_blocking(prec, default_blk);
+}
+
+/*
+ * Returns the element of index i of a matrix of the given precision.
+ */
+double element(enum precision prec, const void *X, size_t i)
+{
+    return (prec == PREC_FLOAT) ? (double)((const float *)X)[i] : ((const double *)X)[i];
+}
+
+/*
+ * Write the counters of the measured repetitions (per call) and the derived
+ * IPC, DRAM bandwidth in GB/s and arithmetic intensity in FLOP/byte, with
+ * the traffic of the IMC counters or else estimated from the LLC misses.
+ * NA for unavailable counters.
+ */
+void print_counters(FILE *out, const struct counters *cnt, double flop, double time, int reps)
+{
+    const char *source;
+    double bytes = counters_traffic(cnt, &source) / reps;
+    int c;
+
+    for (c = 0; c < NCOUNTERS; c++) {
+        if (cnt->available[c])
+            fprintf(out, ", %.0lf", cnt->values[c] / reps);
+        else
+            fprintf(out, ", NA");
+    }
+
+    if (cnt->available[CNT_CYCLES] && cnt->available[CNT_INSTRUCTIONS] && cnt->values[CNT_CYCLES] > 0)
+        fprintf(out, ", %lf", cnt->values[CNT_INSTRUCTIONS] / cnt->values[CNT_CYCLES]);
+    else
+        fprintf(out, ", NA");
+
+    if (source != NULL && bytes > 0)
+        fprintf(out, ", %s, %lf, %lf", source, bytes * reps / time * 1.0e-9, flop / bytes);
+    else
+        fprintf(out, ", NA, NA, NA");
+}
+
+/*
+ * bandwidth : sustained bandwidth of all the cores in GB/s
+ * peak      : peak FMA GFLOP/s of float and double
+ */
+struct roofline
+{
+    double bandwidth;
+    double peak[2];
+};
+
+/*
+ * Read the limits of the machine written by roofline.x ("key value" lines).
+ * Returns 0 on success, -1 if the file can't be read or is incomplete.
+ */
+int read_roofline(const char *file, struct roofline *rf)
+{
+    char line[256], key[64];
+    double value;
+    FILE *fp = fopen(file, "r");
+
+    memset(rf, 0, sizeof(*rf));
+    if (fp == NULL)
+        return -1;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "%63s %lf", key, &value) != 2)
+            continue;
+        if (strcmp(key, "bandwidth") == 0)
+            rf->bandwidth = value;
+        else if (strcmp(key, "peak_float") == 0)
+            rf->peak[PREC_FLOAT] = value;
+        else if (strcmp(key, "peak_double") == 0)
+            rf->peak[PREC_DOUBLE] = value;
+    }
+    fclose(fp);
+    return (rf->bandwidth > 0.0 && rf->peak[PREC_FLOAT] > 0.0 && rf->peak[PREC_DOUBLE] > 0.0) ? 0 : -1;
+}
+
+/*
+ * Write the arithmetic intensity, the attainable performance min(peak, ai * bandwidth)
+ * and the percentage of it reached. The intensity is the measured one when the
+ * counters are available, otherwise the one of the compulsory traffic (A, B and C once).
+ */
+void print_roofline(FILE *out, const struct roofline *rf, const struct counters *cnt, enum precision prec,
+                    int m, int k, int n, int count, int reps, double gflops)
+{
+    double flop = 2.0 * m * n * k * count, ai, attainable, bytes = 0.0;
+    const char *source = NULL;
+
+    if (cnt != NULL)
+        bytes = counters_traffic(cnt, &source) / reps;
+    if (source != NULL && bytes > 0)
+        ai = flop / bytes;
+    else
+        ai = flop / (precision_size(prec) * count * ((double)m*k + (double)k*n + (double)m*n));
+    attainable = min(rf->peak[prec], ai * rf->bandwidth);
+    fprintf(out, ", %lf, %lf, %lf", ai, attainable, 100.0 * gflops / attainable);
+}
+
+/*
+ * Run the multiplication (or the batch if bt is not NULL, the reduced or
+ * mixed precision one if mx is not NULL) with a backend.
+ * Returns 1 if the batched API of the backend was used, 0 otherwise.
+ */
+int run_gemm(struct backend *b, enum precision prec, int m, int n, int k, double alpha, double beta,
+             void *A, void *B, void *C, const struct batch *bt, int loop, struct mixed *mx)
+{
+    if (mx != NULL) {
+        mixed_gemm(mx, b, (double *)C);
+        return 0;
+    }
+    if (bt != NULL)
+        return backend_gemm_batch(b, prec, m, n, k, alpha, beta, bt, loop);
+    backend_gemm(b, prec, m, n, k, alpha, A, m, B, k, beta, C, m);
+    return 0;
+}
+
+void usage(char *name)
+{
+    printf("Usage: %s [-b backends] [-p precision] [-B MC,KC,NC] [-T] [-C cache] [-m policy] [-A align] [-H] [-P roofline.dat] [-N count [-G layout] [-L]] [-V [-t tol]] [-w warmup] [-r reps] [-s shapes] [-o file.csv] [M K N]\n", name);
+    printf("  -b list     comma separated backends name[=library], name is mkl, oblas, blis, native or ref (default %s)\n", BACKENDS);
+    printf("  -p prec     float (sgemm), double (dgemm), bf16 or fp16 (16 bit inputs, fp32 accumulation) or refined\n");
+    printf("              (double accuracy from sgemm), the last three add the error against the native dgemm (default double)\n");
+    printf("  -B MC,KC,NC blocking of the native backend (default %d,%d,%d for float, %d,%d,%d for double)\n",
+           native_get_blocking(PREC_FLOAT).mc, native_get_blocking(PREC_FLOAT).kc, native_get_blocking(PREC_FLOAT).nc,
+           native_get_blocking(PREC_DOUBLE).mc, native_get_blocking(PREC_DOUBLE).kc, native_get_blocking(PREC_DOUBLE).nc);
+    printf("  -T          autotune threads, places/bind (and blocking of native) for each backend and shape\n");
+    printf("  -C file     cache of the tuned configurations, none to disable it (default %s)\n", TUNE_CACHE);
+    printf("  -m policy   allocation of the matrices: first (first touch), interleave (NUMA nodes) or huge (huge pages) (default first)\n");
+    printf("  -A bytes    alignment of the matrices with the first touch policy, a power of two (default malloc)\n");
+    printf("  -H          read the hardware counters (perf events) of the measured repetitions\n");
+    printf("  -P file     limits of the machine written by roofline.x, adds the percentage of the attainable roofline\n");
+    printf("  -N count    batch mode: count independent multiplications of each shape, aggregate GFLOP/s\n");
+    printf("  -G layout   layout of the batch: array (pointer arrays) or strided (default strided)\n");
+    printf("  -L          batch with an OpenMP loop of single threaded calls even if the backend has a batched API\n");
+    printf("  -V          verify C of the last repetition (Freivalds' check in long double), flags the failures in the CSV\n");
+    printf("  -t tol      tolerance of the verification, relative to |A| |B| (default k unit roundoffs)\n");
+    printf("  -w warmup   untimed repetitions before the measured ones (default %d)\n", WARMUP);
+    printf("  -r reps     measured repetitions of each shape (default %d)\n", REPS);
+    printf("  -s shapes   comma separated list of S (square), MxKxN or A-B:S (square sweep)\n");
+    printf("  -o file     append the results to a CSV file (the header is written if the file is empty, the\n");
+    printf("              file is refused if it has different columns)\n");
+    printf("  M K N       a single shape, the matrices will be A(M,K) B(K,N)\n");
+}
+
 int main(int argc, char** argv)
 {
-    MYFLOAT *A, *B, *C;
-    int m, n, k, i, j;
-    MYFLOAT alpha, beta;
+    void *A, *B, *C;
+    int m = 0, n = 0, k = 0, r, s, l, opt;
+    double alpha, beta;
     struct timespec begin, end;
     double elapsed;
-    if (argc == 1)
+    int warmup = WARMUP, reps = REPS;
+    char *output = NULL, header[1024];
+    struct shape *shapes = NULL;
+    int nshapes = 0, capacity = 0;
+    FILE *out = stdout;
+    char *backend_list = BACKENDS;
+    struct backend *backends = NULL;
+    int nbackends;
+    enum precision prec = PREC_DOUBLE, compute;
+    enum mixed_mode mode = MIXED_NONE;
+    struct mixed mx, *mixed = NULL;
+    struct backend reference;
+    double *ref = NULL;
+    int verify = 0, failed = 0;
+    double residual = 0.0, tol = 0.0, tol_given = 0.0;
+    struct blocking blk = { 0, 0, 0 }, default_blk;
+    struct tune_config cfg;
+    char *cache = TUNE_CACHE;
+    struct counters cnt;
+    int hwc = 0;
+    struct roofline rf;
+    char *roofline = NULL;
+    struct batch bt, *batch = NULL;
+    int nbatch = 0, loop = 0, api = 0, bi;
+    enum batch_layout layout = BATCH_STRIDED;
+    int tune = 0, default_threads = omp_get_max_threads(), blocking_given;
+    enum alloc_policy policy = ALLOC_FIRST_TOUCH;
+    size_t alignment = 0;
+    struct buffer bufA, bufB, bufC;
+
+    while ((opt = getopt(argc, argv, "b:p:B:TC:m:A:HP:N:G:LVt:w:r:s:o:h")) != -1) {
+        switch (opt) {
+        case 'b':
+            backend_list = optarg;
+            break;
+        case 'p':
+            if (strcmp(optarg, "float") == 0) {
+                prec = PREC_FLOAT;
+            } else if (strcmp(optarg, "double") == 0) {
+                prec = PREC_DOUBLE;
+            } else if (parse_mixed(optarg, &mode) == 0) {
+                /* double inputs and reference, the multiplications are sgemm */
+                prec = PREC_DOUBLE;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'B':
+            if (sscanf(optarg, "%d,%d,%d", &blk.mc, &blk.kc, &blk.nc) != 3) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'T':
+            tune = 1;
+            break;
+        case 'C':
+            cache = optarg;
+            break;
+        case 'm':
+            if (parse_policy(optarg, &policy) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'A':
+            alignment = strtoul(optarg, NULL, 10);
+            if (alignment & (alignment - 1)) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'H':
+            hwc = 1;
+            break;
+        case 'P':
+            roofline = optarg;
+            break;
+        case 'N':
+            nbatch = atoi(optarg);
+            break;
+        case 'G':
+            if (strcmp(optarg, "array") == 0) {
+                layout = BATCH_ARRAY;
+            } else if (strcmp(optarg, "strided") == 0) {
+                layout = BATCH_STRIDED;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'L':
+            loop = 1;
+            break;
+        case 'V':
+            verify = 1;
+            break;
+        case 't':
+            tol_given = atof(optarg);
+            break;
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 's':
+            if (parse_shapes(optarg, &shapes, &nshapes, &capacity) == 0) {
+                printf("Malformed list of shapes: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 0;
+        }
+    }
+
+    if (argc - optind == 3)
     {
-    m = 2000, k = 200, n = 1000;
+        add_shape(&shapes, &nshapes, &capacity, atoi(argv[optind]), atoi(argv[optind + 1]), atoi(argv[optind + 2]));
     }
-    else if (argc == 4)
+    else if (argc - optind != 0 || warmup < 0 || reps < 1 || nbatch < 0)
     {
-        m = atoi(argv[1]);
-        k = atoi(argv[2]);
-        n = atoi(argv[3]);
+        usage(argv[0]);
+        return 0;
     }
-    else
+    if (nshapes == 0)
     {
-    printf( "Usage: %s M K N, the corresponding matrices will be  A(M,K) B(K,N) \n", argv[0]); 
-    return 0; 
+        add_shape(&shapes, &nshapes, &capacity, 2000, 200, 1000);
+    }
+
+    if (roofline != NULL && read_roofline(roofline, &rf) != 0) {
+        printf("\n ERROR: Can't read the roofline %s (run roofline.x). Aborting... \n\n", roofline);
+        return 1;
+    }
+
+    if (mode != MIXED_NONE && (nbatch > 0 || tune)) {
+        printf("\n ERROR: %s is not available in batch mode and with the autotuning. Aborting... \n\n",
+               mixed_name(mode));
+        return 1;
+    }
+    compute = (mode != MIXED_NONE) ? PREC_FLOAT : prec;
+
+    native_set_blocking(compute, blk);
+    default_blk = native_get_blocking(compute);
+    blocking_given = (blk.mc > 0 || blk.kc > 0 || blk.nc > 0);
+
+    nbackends = load_backends(backend_list, &backends);
+    if (nbackends == 0)
+        return 1;
+    /* the reference is the in-tree blocked dgemm (verified with -V), fast enough for large shapes */
+    if (mode != MIXED_NONE && backend_load(&reference, "native", NULL) != 0)
+        return 1;
+
+    if (tune) {
+        for (s = 0; s < nshapes; s++)
+            for (l = 0; l < nbackends; l++)
+                if (autotune(SELF, &backends[l], prec, shapes[s].m, shapes[s].k, shapes[s].n,
+                             warmup, reps, &cfg) == 0) {
+                    printf("best: %s %s %dx%dx%d threads %d places %s bind %s -> %lf GFLOP/s\n",
+                           backends[l].name, precision_name(prec), shapes[s].m, shapes[s].k, shapes[s].n,
+                           cfg.threads, cfg.places, cfg.bind, cfg.gflops);
+                    tune_store(cache, backends[l].name, prec, shapes[s].m, shapes[s].k, shapes[s].n, &cfg);
+                }
+        for (l = 0; l < nbackends; l++)
+            backend_close(&backends[l]);
+        free(backends);
+        free(shapes);
+        return 0;
+    }
+
+    /* places and bind are fixed when OpenMP starts: if they are not set, restart
+       with the tuned ones, the same for every backend and shape of the sweep */
+    if (getenv("OMP_PLACES") == NULL && getenv("OMP_PROC_BIND") == NULL) {
+        struct tune_config first;
+        int found = 0;
+
+        for (s = 0; s < nshapes; s++)
+            for (l = 0; l < nbackends; l++) {
+                if (!tune_lookup(cache, backends[l].name, prec, shapes[s].m, shapes[s].k, shapes[s].n, &cfg))
+                    continue;
+                if (!found) {
+                    first = cfg;
+                    found = 1;
+                } else if (strcmp(cfg.places, first.places) != 0 || strcmp(cfg.bind, first.bind) != 0) {
+                    printf("\n ERROR: the tuned places/bind of %s %dx%dx%d (%s/%s) differ from %s/%s, "
+                           "set OMP_PLACES and OMP_PROC_BIND or split the sweep. Aborting... \n\n",
+                           backends[l].name, shapes[s].m, shapes[s].k, shapes[s].n, cfg.places, cfg.bind,
+                           first.places, first.bind);
+                    return 1;
+                }
+            }
+        if (found) {
+            setenv("OMP_PLACES", first.places, 1);
+            setenv("OMP_PROC_BIND", first.bind, 1);
+            fflush(stdout);
+            execv(SELF, argv);
+        }
+    }
+
+    if (output != NULL) {
+        snprintf(header, sizeof(header), "%s%s%s%s%s%s", CSV_HEADER, hwc ? CSV_COUNTERS : "",
+                 roofline ? CSV_ROOFLINE : "", nbatch ? CSV_BATCH : "", mode != MIXED_NONE ? CSV_ERROR : "",
+                 verify ? CSV_VERIFY : "");
+        /* the rows are appended only under the same columns */
+        if (!same_header(output, header)) {
+            printf("\n ERROR: %s has different columns, use a new file. Aborting... \n\n", output);
+            return 1;
+        }
+        out = fopen(output, "a");
+        if (out == NULL) {
+            printf("\n ERROR: Can't open %s. Aborting... \n\n", output);
+            return 1;
+        }
+        if (ftell(out) == 0)
+            fprintf(out, "%s\n", header);
     }
 
     alpha = 1.0; beta = 0.0;
 
-    A = (MYFLOAT *)malloc( m*k*sizeof( MYFLOAT ));
-    B = (MYFLOAT *)malloc( k*n*sizeof( MYFLOAT ));
-    C = (MYFLOAT *)malloc( m*n*sizeof( MYFLOAT ));
-    if (A == NULL || B == NULL || C == NULL) {
+    /* the matrices of a batch are contiguous */
+    if (nbatch > 0) {
+        memset(&bt, 0, sizeof(bt));
+        bt.layout = layout;
+        bt.count = nbatch;
+        bt.a = (const void **)malloc(nbatch * sizeof(void *));
+        bt.b = (const void **)malloc(nbatch * sizeof(void *));
+        bt.c = (void **)malloc(nbatch * sizeof(void *));
+        batch = &bt;
+    }
+
+    memset(&bufA, 0, sizeof(bufA));
+    memset(&bufB, 0, sizeof(bufB));
+    memset(&bufC, 0, sizeof(bufC));
+    double *times = (double *)malloc( reps*sizeof( double ));
+    if (times == NULL) {
       printf( "\n ERROR: Can't allocate memory for matrices. Aborting... \n\n");
-      free(A);
-      free(B);
-      free(C);
       return 1;
     }
 
-    for (i = 0; i < (m*k); i++) {
-        A[i] = (MYFLOAT)(i+1);
+    for (s = 0; s < nshapes; s++) {
+    m = shapes[s].m; k = shapes[s].k; n = shapes[s].n;
+
+    /* same threads of the (first) GEMM call */
+    apply_config(cache, &backends[0], compute, m, k, n, default_threads, default_blk, blocking_given);
+
+    /* new buffers for each shape: the pages are first touched with the split of
+       this shape, not of the first one of the sweep */
+    free_buffer(&bufA);
+    free_buffer(&bufB);
+    free_buffer(&bufC);
+    free(ref);
+    ref = NULL;
+    size_t na = (size_t)m*k*(nbatch ? nbatch : 1), nb = (size_t)k*n*(nbatch ? nbatch : 1);
+    size_t nc = (size_t)m*n*(nbatch ? nbatch : 1);
+    alloc_buffer(&bufA, na*precision_size( prec ), policy, alignment);
+    alloc_buffer(&bufB, nb*precision_size( prec ), policy, alignment);
+    alloc_buffer(&bufC, nc*precision_size( prec ), policy, alignment);
+    A = bufA.ptr;
+    B = bufB.ptr;
+    C = bufC.ptr;
+    if (mode != MIXED_NONE)
+        ref = (double *)malloc(nc*sizeof(double));
+    if (A == NULL || B == NULL || C == NULL || (mode != MIXED_NONE && ref == NULL)) {
+      printf( "\n ERROR: Can't allocate memory for matrices. Aborting... \n\n");
+      free_buffer(&bufA);
+      free_buffer(&bufB);
+      free_buffer(&bufC);
+      free(times);
+      free(ref);
+      return 1;
+    }
+
+    if (mode != MIXED_NONE) {
+        init_uniform((double *)A, (double *)B, (double *)C, na, nb, nc);
+        backend_gemm(&reference, PREC_DOUBLE, m, n, k, 1.0, A, m, B, k, 0.0, ref, m);
+    } else {
+        init_matrices(prec, A, B, C, na, nb, nc);
+    }
+
+    if (batch != NULL) {
+        bt.A = A;
+        bt.B = B;
+        bt.C = C;
+        bt.stride_a = m*k;
+        bt.stride_b = k*n;
+        bt.stride_c = m*n;
+        for (bi = 0; bi < nbatch; bi++) {
+            bt.a[bi] = (const char *)A + (size_t)bi*m*k*precision_size(prec);
+            bt.b[bi] = (const char *)B + (size_t)bi*k*n*precision_size(prec);
+            bt.c[bi] = (char *)C + (size_t)bi*m*n*precision_size(prec);
+        }
     }
 
-    for (i = 0; i < (k*n); i++) {
-        B[i] = (MYFLOAT)(-i-1);
+    /* all the backends run on the same, already touched, buffers */
+    for (l = 0; l < nbackends; l++) {
+    apply_config(cache, &backends[l], compute, m, k, n, default_threads, default_blk, blocking_given);
+
+    /* the inputs are rounded (or only referenced) once, out of the measured time */
+    if (mode != MIXED_NONE && mixed_prepare(&mx, &backends[l], mode, A, B, m, k, n) != 0) {
+        printf("\n ERROR: Can't allocate memory for %s. Aborting... \n\n", mixed_name(mode));
+        return 1;
+    }
+    if (mode != MIXED_NONE)
+        mixed = &mx;
+
+    /* untimed repetitions: threads are spawned and caches and TLBs are warm */
+    for (r = 0; r < warmup; r++) {
+        run_gemm(&backends[l], prec, m, n, k, alpha, beta, A, B, C, batch, loop, mixed);
+    }
+
+    /* the threads of the library exist after the warm-up, the counters are opened on all of them */
+    if (hwc && counters_start(&cnt) == 0 && s == 0 && l == 0)
+        printf("Warning: hardware counters are not available (perf_event_paranoid, virtual machine?)\n");
+
+    for (r = 0; r < reps; r++) {
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        api = run_gemm(&backends[l], prec, m, n, k, alpha, beta, A, B, C, batch, loop, mixed);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        times[r] = (double)diff(begin,end).tv_sec + (double)diff(begin,end).tv_nsec / 1000000000.0;
     }
 
-    for (i = 0; i < (m*n); i++) {
-        C[i] = 0.0;
+    if (hwc)
+        counters_stop(&cnt);
+
+    if (mixed != NULL)
+        mixed_result(mixed, (double *)C);
+
+    /* check of the last repetition (all the matrices of a batch), out of the measured time */
+    if (verify) {
+        residual = 0.0;
+        tol = (tol_given > 0.0) ? tol_given : tolerance(prec, mode, m, k, n);
+        for (bi = 0; bi < (nbatch ? nbatch : 1); bi++) {
+            double rb = verify_gemm(prec, m, n, k, batch ? bt.a[bi] : A, batch ? bt.b[bi] : B,
+                                    batch ? bt.c[bi] : C, (unsigned long)s + 1);
+            if (rb < 0.0) {
+                printf("\n ERROR: Can't allocate memory for the verification. Aborting... \n\n");
+                return 1;
+            }
+            residual = fmax(residual, rb);
+        }
+        if (!(residual <= tol)) {
+            failed++;
+            if (out != stdout)
+                printf("Warning: %s %dx%dx%d fails the verification (residual %.3e, tolerance %.3e)\n",
+                       backends[l].name, m, k, n, residual, tol);
+        }
     }
 
-    sleep(1);
-    clock_gettime(CLOCK_MONOTONIC, &begin);
-    GEMMCPU(CblasColMajor, CblasNoTrans, CblasNoTrans,
-                m, n, k, alpha, A, m, B, k, beta, C, m);
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    elapsed = (double)diff(begin,end).tv_sec + (double)diff(begin,end).tv_nsec / 1000000000.0;
-    double gflops = 2.0 * m *n*k;
-    gflops = gflops/elapsed*1.0e-9;     
-    DATATYPE
-    printf("%d, %lf, %lf\n", m, elapsed, gflops);
+    struct measure res = compute_measure(times, reps);
+    double flop = 2.0 * m *n*k * (nbatch ? nbatch : 1);
+    elapsed = res.median;
+    double gflops = flop/elapsed*1.0e-9;
+    fprintf(out, "%s, ", mode != MIXED_NONE ? mixed_name(mode) : precision_name(prec));
+    fprintf(out, "%d, %lf, %lf, %d, %d, %d, %d, %d, %lf, %lf, %lf, %lf, %s", m, elapsed, gflops,
+            m, k, n, warmup, reps, res.min, res.mean, res.stddev, flop/res.min*1.0e-9, backends[l].name);
+    if (hwc)
+        print_counters(out, &cnt, flop, res.mean * reps, reps);
+    if (roofline != NULL)
+        print_roofline(out, &rf, hwc ? &cnt : NULL, compute, m, k, n, nbatch ? nbatch : 1, reps, gflops);
+    if (nbatch)
+        fprintf(out, ", %d, %s, %s", nbatch, layout == BATCH_ARRAY ? "array" : "strided", api ? "batch" : "loop");
+    if (mode != MIXED_NONE) {
+        fprintf(out, ", %.3e", max_error((const double *)C, ref, (size_t)m*n));
+        mixed_free(&mx);
+    }
+    if (verify)
+        fprintf(out, ", %.3e, %.3e, %s", residual, tol, residual <= tol ? "ok" : "FAIL");
+    fprintf(out, "\n");
+    fflush(out);
+    }
+    }
 
 #ifdef PRINT
+    {
+    int i, j;
+
     printf (" Top left corner of matrix A: \n");
     for (i=0; i<min(m,6); i++) {
       for (j=0; j<min(k,6); j++) {
-        printf ("%12.0f", A[j+i*k]);
+        printf ("%12.0f", element(prec, A, i+(size_t)j*m));
       }
       printf ("\n");
     }
@@ -120,7 +852,7 @@ int main(int argc, char** argv)
     printf ("\n Top left corner of matrix B: \n");
     for (i=0; i<min(k,6); i++) {
       for (j=0; j<min(n,6); j++) {
-        printf ("%12.0f", B[j+i*n]);
+        printf ("%12.0f", element(prec, B, i+(size_t)j*k));
       }
       printf ("\n");
     }
@@ -128,14 +860,31 @@ int main(int argc, char** argv)
     printf ("\n Top left corner of matrix C: \n");
     for (i=0; i<min(m,6); i++) {
       for (j=0; j<min(n,6); j++) {
-        printf ("%12.5G", C[j+i*n]);
+        printf ("%12.5G", element(prec, C, i+(size_t)j*m));
       }
       printf ("\n");
     }
+    }
 #endif
-    free(A);
-    free(B);
-    free(C);
+    if (out != stdout)
+        fclose(out);
+    free_buffer(&bufA);
+    free_buffer(&bufB);
+    free_buffer(&bufC);
+    free(times);
+    free(ref);
+    if (mode != MIXED_NONE)
+        backend_close(&reference);
+    free(shapes);
+    if (batch != NULL) {
+        free(bt.a);
+        free(bt.b);
+        free(bt.c);
+    }
+    for (l = 0; l < nbackends; l++)
+        backend_close(&backends[l]);
+    free(backends);
 
-    return 0;
+    /* a failed verification is also reported in the exit status */
+    return failed ? 2 : 0;
 }
\ No newline at end of file
@@ -0,0 +1,302 @@
+/*
+ * Reduced and mixed precision GEMM.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mixed.h"
+
+#define min(x,y) (((x) < (y)) ? (x) : (y))
+
+static float as_float(uint32_t x)
+{
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+static uint32_t as_uint(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    return x;
+}
+
+/*
+ * float -> bf16, round to nearest even.
+ */
+static unsigned short float_to_bf16(float f)
+{
+    uint32_t x = as_uint(f);
+
+    if ((x & 0x7fffffffu) > 0x7f800000u)
+        return (unsigned short)((x >> 16) | 0x40);
+    x += 0x7fffu + ((x >> 16) & 1);
+    return (unsigned short)(x >> 16);
+}
+
+static float bf16_to_float(unsigned short h)
+{
+    return as_float((uint32_t)h << 16);
+}
+
+/*
+ * float -> fp16, round to nearest even, overflow to infinity.
+ */
+static unsigned short float_to_fp16(float f)
+{
+    const uint32_t f32_inf = 255u << 23, f16_max = (127u + 16u) << 23;
+    const float denormal_magic = as_float(((127u - 15u) + (23u - 10u) + 1u) << 23);
+    uint32_t x = as_uint(f), sign = x & 0x80000000u, o;
+
+    x ^= sign;
+    if (x >= f16_max) {
+        o = (x > f32_inf) ? 0x7e00 : 0x7c00;
+    } else if (x < (113u << 23)) {
+        /* subnormal (or zero) in fp16: the addition rounds the mantissa */
+        o = as_uint(as_float(x) + denormal_magic) - as_uint(denormal_magic);
+    } else {
+        uint32_t odd = (x >> 13) & 1;
+        x += ((15u - 127u) << 23) + 0xfff + odd;
+        o = x >> 13;
+    }
+    return (unsigned short)(o | (sign >> 16));
+}
+
+static float fp16_to_float(unsigned short h)
+{
+    const float magic = as_float(113u << 23);
+    const uint32_t shifted_exp = 0x7c00u << 13;
+    uint32_t o = ((uint32_t)h & 0x7fffu) << 13;
+    uint32_t exp = shifted_exp & o;
+
+    o += (127u - 15u) << 23;
+    if (exp == shifted_exp)
+        o += (128u - 16u) << 23;
+    else if (exp == 0)
+        o = as_uint(as_float(o + (1u << 23)) - magic);
+    o |= ((uint32_t)h & 0x8000u) << 16;
+    return as_float(o);
+}
+
+int parse_mixed(const char *name, enum mixed_mode *mode)
+{
+    if (strcmp(name, "bf16") == 0)
+        *mode = MIXED_BF16;
+    else if (strcmp(name, "fp16") == 0)
+        *mode = MIXED_FP16;
+    else if (strcmp(name, "refined") == 0)
+        *mode = MIXED_REFINED;
+    else
+        return -1;
+    return 0;
+}
+
+const char *mixed_name(enum mixed_mode mode)
+{
+    switch (mode) {
+    case MIXED_BF16: return "bf16";
+    case MIXED_FP16: return "fp16";
+    case MIXED_REFINED: return "refined";
+    default: return "none";
+    }
+}
+
+/*
+ * Round n doubles to 16 bits (and widen them to fp32 if wide is not NULL).
+ */
+static void convert_16(enum mixed_mode mode, const double *X, size_t n, unsigned short *h, float *wide)
+{
+    long i;
+
+    #pragma omp parallel for schedule(static)
+    for (i = 0; i < (long)n; i++) {
+        h[i] = (mode == MIXED_BF16) ? float_to_bf16((float)X[i]) : float_to_fp16((float)X[i]);
+        if (wide != NULL)
+            wide[i] = (mode == MIXED_BF16) ? bf16_to_float(h[i]) : fp16_to_float(h[i]);
+    }
+}
+
+int mixed_prepare(struct mixed *mx, const struct backend *b, enum mixed_mode mode,
+                  const double *A, const double *B, int m, int k, int n)
+{
+    size_t mk = (size_t)m * k, kn = (size_t)k * n, mn = (size_t)m * n;
+
+    memset(mx, 0, sizeof(*mx));
+    mx->mode = mode;
+    mx->m = m;
+    mx->k = k;
+    mx->n = n;
+
+    if (mode == MIXED_REFINED) {
+        mx->A = A;
+        mx->B = B;
+        mx->as = (float *)malloc(SPLIT_SLICES * (size_t)m * SPLIT_KC * sizeof(float));
+        mx->bs = (float *)malloc(SPLIT_SLICES * (size_t)SPLIT_KC * n * sizeof(float));
+        mx->t = (float *)malloc(mn * sizeof(float));
+        mx->ea = (int *)malloc(m * sizeof(int));
+        mx->eb = (int *)malloc(n * sizeof(int));
+        return (mx->as && mx->bs && mx->t && mx->ea && mx->eb) ? 0 : -1;
+    }
+
+    mx->native = (mode == MIXED_BF16) ? (b->gemm_bf16 != NULL) : (b->gemm_f16 != NULL);
+    mx->a16 = (unsigned short *)malloc(mk * sizeof(unsigned short));
+    mx->b16 = (unsigned short *)malloc(kn * sizeof(unsigned short));
+    mx->c32 = (float *)malloc(mn * sizeof(float));
+    if (!mx->native) {
+        mx->a32 = (float *)malloc(mk * sizeof(float));
+        mx->b32 = (float *)malloc(kn * sizeof(float));
+        if (mx->a32 == NULL || mx->b32 == NULL)
+            return -1;
+    }
+    if (mx->a16 == NULL || mx->b16 == NULL || mx->c32 == NULL)
+        return -1;
+
+    convert_16(mode, A, mk, mx->a16, mx->a32);
+    convert_16(mode, B, kn, mx->b16, mx->b32);
+    return 0;
+}
+
+/*
+ * Split the columns pc..pc+kw of A (by rows, exponents ea) in slices: slice s
+ * of a(i,p) is the integer q_s with a = sum q_s 2^(ea(i) - (s+1) bits) + residual.
+ */
+static void split_a(const struct mixed *mx, int pc, int kw)
+{
+    int m = mx->m, p;
+    size_t slice = (size_t)m * kw;
+
+    #pragma omp parallel for schedule(static)
+    for (p = 0; p < kw; p++) {
+        int i, s;
+        for (i = 0; i < m; i++) {
+            double r = mx->A[i + (size_t)(pc + p) * m];
+            for (s = 0; s < SPLIT_SLICES; s++) {
+                int e = mx->ea[i] - (s + 1) * SPLIT_BITS;
+                double q = trunc(ldexp(r, -e));
+                mx->as[s * slice + i + (size_t)p * m] = (float)q;
+                r -= ldexp(q, e);
+            }
+        }
+    }
+}
+
+/*
+ * Split the rows pc..pc+kw of B (by columns, exponents eb) in slices of kw x n.
+ */
+static void split_b(const struct mixed *mx, int pc, int kw)
+{
+    int k = mx->k, n = mx->n, j;
+    size_t slice = (size_t)kw * n;
+
+    #pragma omp parallel for schedule(static)
+    for (j = 0; j < n; j++) {
+        int p, s;
+        for (p = 0; p < kw; p++) {
+            double r = mx->B[(pc + p) + (size_t)j * k];
+            for (s = 0; s < SPLIT_SLICES; s++) {
+                int e = mx->eb[j] - (s + 1) * SPLIT_BITS;
+                double q = trunc(ldexp(r, -e));
+                mx->bs[s * slice + p + (size_t)j * kw] = (float)q;
+                r -= ldexp(q, e);
+            }
+        }
+    }
+}
+
+static void refined_gemm(struct mixed *mx, struct backend *b, double *C)
+{
+    int m = mx->m, k = mx->k, n = mx->n, i, j, pc, s, t;
+    long idx;
+
+    /* exponents: |A(i,:)| < 2^ea(i), |B(:,j)| < 2^eb(j) */
+    #pragma omp parallel for private(j)
+    for (i = 0; i < m; i++) {
+        double amax = 0.0;
+        for (j = 0; j < k; j++)
+            amax = fmax(amax, fabs(mx->A[i + (size_t)j * m]));
+        frexp(amax, &mx->ea[i]);
+    }
+    #pragma omp parallel for private(i)
+    for (j = 0; j < n; j++) {
+        double bmax = 0.0;
+        for (i = 0; i < k; i++)
+            bmax = fmax(bmax, fabs(mx->B[i + (size_t)j * k]));
+        frexp(bmax, &mx->eb[j]);
+    }
+
+    memset(C, 0, (size_t)m * n * sizeof(double));
+
+    for (pc = 0; pc < k; pc += SPLIT_KC) {
+        int kw = min(SPLIT_KC, k - pc);
+
+        split_a(mx, pc, kw);
+        split_b(mx, pc, kw);
+
+        /* products of the slices above the double precision: s + t < slices */
+        for (s = 0; s < SPLIT_SLICES; s++)
+            for (t = 0; s + t < SPLIT_SLICES; t++) {
+                double factor = ldexp(1.0, -(s + t + 2) * SPLIT_BITS);
+
+                /* exact: kw * (2^bits - 1)^2 < 2^24 */
+                b->sgemm(CBLAS_COL_MAJOR, CBLAS_NO_TRANS, CBLAS_NO_TRANS, m, n, kw,
+                         1.0f, mx->as + (size_t)s * m * kw, m, mx->bs + (size_t)t * kw * n, kw,
+                         0.0f, mx->t, m);
+
+                #pragma omp parallel for schedule(static)
+                for (idx = 0; idx < (long)m * n; idx++)
+                    C[idx] += factor * mx->t[idx];
+            }
+    }
+
+    #pragma omp parallel for private(i)
+    for (j = 0; j < n; j++)
+        for (i = 0; i < m; i++)
+            C[i + (size_t)j * m] = ldexp(C[i + (size_t)j * m], mx->ea[i] + mx->eb[j]);
+}
+
+void mixed_gemm(struct mixed *mx, struct backend *b, double *C)
+{
+    int m = mx->m, k = mx->k, n = mx->n;
+
+    if (mx->mode == MIXED_REFINED)
+        refined_gemm(mx, b, C);
+    else if (mx->native && mx->mode == MIXED_BF16)
+        b->gemm_bf16(CBLAS_COL_MAJOR, CBLAS_NO_TRANS, CBLAS_NO_TRANS, m, n, k,
+                     1.0f, mx->a16, m, mx->b16, k, 0.0f, mx->c32, m);
+    else if (mx->native)
+        b->gemm_f16(CBLAS_COL_MAJOR, CBLAS_NO_TRANS, CBLAS_NO_TRANS, m, n, k,
+                    1.0f, mx->a16, m, mx->b16, k, 0.0f, mx->c32, m);
+    else
+        b->sgemm(CBLAS_COL_MAJOR, CBLAS_NO_TRANS, CBLAS_NO_TRANS, m, n, k,
+                 1.0f, mx->a32, m, mx->b32, k, 0.0f, mx->c32, m);
+}
+
+void mixed_result(const struct mixed *mx, double *C)
+{
+    long i;
+
+    if (mx->mode == MIXED_REFINED)
+        return;
+    #pragma omp parallel for schedule(static)
+    for (i = 0; i < (long)mx->m * mx->n; i++)
+        C[i] = mx->c32[i];
+}
+
+void mixed_free(struct mixed *mx)
+{
+    free(mx->a16);
+    free(mx->b16);
+    free(mx->a32);
+    free(mx->b32);
+    free(mx->c32);
+    free(mx->as);
+    free(mx->bs);
+    free(mx->t);
+    free(mx->ea);
+    free(mx->eb);
+    memset(mx, 0, sizeof(*mx));
+}
@@ -0,0 +1,84 @@
+/*
+ * Reduced and mixed precision GEMM on double inputs:
+ *  - bf16 / fp16: the inputs are rounded to 16 bits and multiplied with fp32
+ *    accumulation, natively (MKL cblas_gemm_bf16bf16f32 / cblas_gemm_f16f16f32)
+ *    or emulated with the sgemm of the backend on the widened inputs (the
+ *    products of 16 bit values are exact in fp32, so the result is the same);
+ *  - refined: double accuracy from sgemm with the splitting of the Ozaki
+ *    scheme: the rows of A and the columns of B are scaled and split in
+ *    slices of SPLIT_BITS bit integers, the products of the slices over
+ *    chunks of SPLIT_KC columns are exact in fp32 and are accumulated in
+ *    double (the products below the double precision are skipped).
+ */
+
+#ifndef MIXED_H
+#define MIXED_H
+
+#include "backend.h"
+
+#define SPLIT_BITS 8
+#define SPLIT_KC 256
+#define SPLIT_SLICES 7
+
+enum mixed_mode { MIXED_NONE, MIXED_BF16, MIXED_FP16, MIXED_REFINED };
+
+/*
+ * mode     : reduced or mixed precision mode
+ * m, k, n  : shape, A(m,k) B(k,n)
+ * native   : 1 if the backend multiplies 16 bit inputs natively
+ * a16, b16 : inputs rounded to bf16/fp16
+ * a32, b32 : inputs rounded to bf16/fp16 and widened to fp32 (emulation)
+ * c32      : fp32 result of the bf16/fp16 modes
+ * A, B     : double inputs of the refined mode
+ * as, bs   : slices of a chunk of A and B (refined)
+ * t        : product of two slices (refined)
+ * ea, eb   : exponents of the rows of A and of the columns of B (refined)
+ */
+struct mixed
+{
+    enum mixed_mode mode;
+    int m, k, n;
+    int native;
+    unsigned short *a16, *b16;
+    float *a32, *b32, *c32;
+    const double *A, *B;
+    float *as, *bs, *t;
+    int *ea, *eb;
+};
+
+/*
+ * Parse the name of a mode (bf16, fp16, refined).
+ * Returns 0 on success, -1 if the name is unknown.
+ */
+int parse_mixed(const char *name, enum mixed_mode *mode);
+
+/*
+ * Returns the name of a mode as written in the CSV.
+ */
+const char *mixed_name(enum mixed_mode mode);
+
+/*
+ * Prepare the multiplication of the double matrices A(m,k) and B(k,n):
+ * conversion of the inputs (not part of the measured time) and buffers.
+ * Returns 0 on success, -1 if the memory can't be allocated.
+ */
+int mixed_prepare(struct mixed *mx, const struct backend *b, enum mixed_mode mode,
+                  const double *A, const double *B, int m, int k, int n);
+
+/*
+ * C = A * B in the mode of mx. The refined mode writes the double C, the
+ * other ones their fp32 result (copied in C by mixed_result).
+ */
+void mixed_gemm(struct mixed *mx, struct backend *b, double *C);
+
+/*
+ * Copy the result of the last multiplication in the double C.
+ */
+void mixed_result(const struct mixed *mx, double *C);
+
+/*
+ * Release the buffers.
+ */
+void mixed_free(struct mixed *mx);
+
+#endif
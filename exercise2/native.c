@@ -0,0 +1,487 @@
+/*
+ * In-tree GEMM in the GotoBLAS/BLIS style.
+ *
+ * C(m,n) = alpha * A(m,k) * B(k,n) + beta * C(m,n), column major:
+ *
+ *   for jc in n step NC
+ *     for pc in k step KC            pack B(pc:pc+KC, jc:jc+NC)  (shared, L3)
+ *       for ic in m step MC          pack alpha*A(ic:ic+MC, pc:pc+KC) (per thread, L2)
+ *         for jr in NC step NR
+ *           for ir in MC step MR     micro-kernel: C(MR,NR) += A(MR,KC) * B(KC,NR)
+ *
+ * The packed panels are read with unit stride by the micro-kernel, which
+ * keeps the MR x NR block of C in registers. Partial tiles at the borders
+ * are zero padded in the panels and computed in a temporary tile.
+ * The threads share the packing of B and split the MC blocks of A.
+ */
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include <omp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "native.h"
+
+#define min(x,y) (((x) < (y)) ? (x) : (y))
+
+#define ALIGNMENT 64
+
+/* largest micro-tile of all the kernels (avx512 float: 32 x 12) */
+#define MAX_TILE (32 * 12)
+
+typedef void (*kernel_fn)(int kc, const void *a, const void *b, void *c, int ldc);
+
+/*
+ * name : name of the instruction set
+ * mr   : rows of the micro-tile of C
+ * nr   : columns of the micro-tile of C
+ * fn   : micro-kernel
+ */
+struct kernel
+{
+    const char *name;
+    int mr, nr;
+    kernel_fn fn;
+};
+
+/* default blocking: a KC x NR panel of B in L1, MC x KC of A in L2, KC x NC of B in L3 */
+static struct blocking blocking_float = { 144, 512, 4080 };
+static struct blocking blocking_double = { 144, 256, 4080 };
+
+/* ---------------------------------------------------------------------- */
+/* micro-kernels: c(mr,nr) += a(mr,kc) * b(kc,nr), a and b packed         */
+/* ---------------------------------------------------------------------- */
+
+#define GENERIC_MR 8
+#define GENERIC_NR 4
+
+static void skernel_generic(int kc, const void *pa, const void *pb, void *pc, int ldc)
+{
+    const float *a = (const float *)pa, *b = (const float *)pb;
+    float *c = (float *)pc;
+    float acc[GENERIC_NR][GENERIC_MR] = { { 0 } };
+    int i, j, p;
+
+    for (p = 0; p < kc; p++, a += GENERIC_MR, b += GENERIC_NR)
+        for (j = 0; j < GENERIC_NR; j++)
+            for (i = 0; i < GENERIC_MR; i++)
+                acc[j][i] += a[i] * b[j];
+    for (j = 0; j < GENERIC_NR; j++)
+        for (i = 0; i < GENERIC_MR; i++)
+            c[i + (size_t)j*ldc] += acc[j][i];
+}
+
+static void dkernel_generic(int kc, const void *pa, const void *pb, void *pc, int ldc)
+{
+    const double *a = (const double *)pa, *b = (const double *)pb;
+    double *c = (double *)pc;
+    double acc[GENERIC_NR][GENERIC_MR] = { { 0 } };
+    int i, j, p;
+
+    for (p = 0; p < kc; p++, a += GENERIC_MR, b += GENERIC_NR)
+        for (j = 0; j < GENERIC_NR; j++)
+            for (i = 0; i < GENERIC_MR; i++)
+                acc[j][i] += a[i] * b[j];
+    for (j = 0; j < GENERIC_NR; j++)
+        for (i = 0; i < GENERIC_MR; i++)
+            c[i + (size_t)j*ldc] += acc[j][i];
+}
+
+#if defined(__x86_64__)
+
+/* AVX2: two vectors of rows times 6 columns, 12 accumulators out of 16 registers */
+#define AVX2_NR 6
+
+__attribute__((target("avx2,fma")))
+static void skernel_avx2(int kc, const void *pa, const void *pb, void *pc, int ldc)
+{
+    const float *a = (const float *)pa, *b = (const float *)pb;
+    float *c = (float *)pc;
+    __m256 c0[AVX2_NR], c1[AVX2_NR];
+    int j, p;
+
+    #pragma GCC unroll 6
+    for (j = 0; j < AVX2_NR; j++) {
+        c0[j] = _mm256_setzero_ps();
+        c1[j] = _mm256_setzero_ps();
+    }
+    for (p = 0; p < kc; p++, a += 16, b += AVX2_NR) {
+        __m256 a0 = _mm256_loadu_ps(a), a1 = _mm256_loadu_ps(a + 8);
+        #pragma GCC unroll 6
+        for (j = 0; j < AVX2_NR; j++) {
+            __m256 bj = _mm256_broadcast_ss(b + j);
+            c0[j] = _mm256_fmadd_ps(a0, bj, c0[j]);
+            c1[j] = _mm256_fmadd_ps(a1, bj, c1[j]);
+        }
+    }
+    #pragma GCC unroll 6
+    for (j = 0; j < AVX2_NR; j++) {
+        float *cj = c + (size_t)j*ldc;
+        _mm256_storeu_ps(cj, _mm256_add_ps(_mm256_loadu_ps(cj), c0[j]));
+        _mm256_storeu_ps(cj + 8, _mm256_add_ps(_mm256_loadu_ps(cj + 8), c1[j]));
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void dkernel_avx2(int kc, const void *pa, const void *pb, void *pc, int ldc)
+{
+    const double *a = (const double *)pa, *b = (const double *)pb;
+    double *c = (double *)pc;
+    __m256d c0[AVX2_NR], c1[AVX2_NR];
+    int j, p;
+
+    #pragma GCC unroll 6
+    for (j = 0; j < AVX2_NR; j++) {
+        c0[j] = _mm256_setzero_pd();
+        c1[j] = _mm256_setzero_pd();
+    }
+    for (p = 0; p < kc; p++, a += 8, b += AVX2_NR) {
+        __m256d a0 = _mm256_loadu_pd(a), a1 = _mm256_loadu_pd(a + 4);
+        #pragma GCC unroll 6
+        for (j = 0; j < AVX2_NR; j++) {
+            __m256d bj = _mm256_broadcast_sd(b + j);
+            c0[j] = _mm256_fmadd_pd(a0, bj, c0[j]);
+            c1[j] = _mm256_fmadd_pd(a1, bj, c1[j]);
+        }
+    }
+    #pragma GCC unroll 6
+    for (j = 0; j < AVX2_NR; j++) {
+        double *cj = c + (size_t)j*ldc;
+        _mm256_storeu_pd(cj, _mm256_add_pd(_mm256_loadu_pd(cj), c0[j]));
+        _mm256_storeu_pd(cj + 4, _mm256_add_pd(_mm256_loadu_pd(cj + 4), c1[j]));
+    }
+}
+
+/* AVX-512: two vectors of rows times 12 columns, 24 accumulators out of 32 registers */
+#define AVX512_NR 12
+
+__attribute__((target("avx512f")))
+static void skernel_avx512(int kc, const void *pa, const void *pb, void *pc, int ldc)
+{
+    const float *a = (const float *)pa, *b = (const float *)pb;
+    float *c = (float *)pc;
+    __m512 c0[AVX512_NR], c1[AVX512_NR];
+    int j, p;
+
+    #pragma GCC unroll 12
+    for (j = 0; j < AVX512_NR; j++) {
+        c0[j] = _mm512_setzero_ps();
+        c1[j] = _mm512_setzero_ps();
+    }
+    for (p = 0; p < kc; p++, a += 32, b += AVX512_NR) {
+        __m512 a0 = _mm512_loadu_ps(a), a1 = _mm512_loadu_ps(a + 16);
+        #pragma GCC unroll 12
+        for (j = 0; j < AVX512_NR; j++) {
+            __m512 bj = _mm512_set1_ps(b[j]);
+            c0[j] = _mm512_fmadd_ps(a0, bj, c0[j]);
+            c1[j] = _mm512_fmadd_ps(a1, bj, c1[j]);
+        }
+    }
+    #pragma GCC unroll 12
+    for (j = 0; j < AVX512_NR; j++) {
+        float *cj = c + (size_t)j*ldc;
+        _mm512_storeu_ps(cj, _mm512_add_ps(_mm512_loadu_ps(cj), c0[j]));
+        _mm512_storeu_ps(cj + 16, _mm512_add_ps(_mm512_loadu_ps(cj + 16), c1[j]));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void dkernel_avx512(int kc, const void *pa, const void *pb, void *pc, int ldc)
+{
+    const double *a = (const double *)pa, *b = (const double *)pb;
+    double *c = (double *)pc;
+    __m512d c0[AVX512_NR], c1[AVX512_NR];
+    int j, p;
+
+    #pragma GCC unroll 12
+    for (j = 0; j < AVX512_NR; j++) {
+        c0[j] = _mm512_setzero_pd();
+        c1[j] = _mm512_setzero_pd();
+    }
+    for (p = 0; p < kc; p++, a += 16, b += AVX512_NR) {
+        __m512d a0 = _mm512_loadu_pd(a), a1 = _mm512_loadu_pd(a + 8);
+        #pragma GCC unroll 12
+        for (j = 0; j < AVX512_NR; j++) {
+            __m512d bj = _mm512_set1_pd(b[j]);
+            c0[j] = _mm512_fmadd_pd(a0, bj, c0[j]);
+            c1[j] = _mm512_fmadd_pd(a1, bj, c1[j]);
+        }
+    }
+    #pragma GCC unroll 12
+    for (j = 0; j < AVX512_NR; j++) {
+        double *cj = c + (size_t)j*ldc;
+        _mm512_storeu_pd(cj, _mm512_add_pd(_mm512_loadu_pd(cj), c0[j]));
+        _mm512_storeu_pd(cj + 8, _mm512_add_pd(_mm512_loadu_pd(cj + 8), c1[j]));
+    }
+}
+
+#endif
+
+/* ---------------------------------------------------------------------- */
+/* run time dispatch                                                      */
+/* ---------------------------------------------------------------------- */
+
+static struct kernel kernel_float, kernel_double;
+/* the first call may come from several threads (e.g. a batch): run once */
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Choose the micro-kernels from the CPU features (or NATIVE_KERNEL).
+ * Called through pthread_once: the kernels are published in one go.
+ */
+static void init_kernels(void)
+{
+    const char *force = getenv("NATIVE_KERNEL");
+    struct kernel sgeneric = { "generic", GENERIC_MR, GENERIC_NR, skernel_generic };
+    struct kernel dgeneric = { "generic", GENERIC_MR, GENERIC_NR, dkernel_generic };
+    struct kernel sk = sgeneric, dk = dgeneric;
+
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") &&
+        (force == NULL || strcmp(force, "avx512") == 0)) {
+        struct kernel s = { "avx512", 32, AVX512_NR, skernel_avx512 };
+        struct kernel d = { "avx512", 16, AVX512_NR, dkernel_avx512 };
+        sk = s;
+        dk = d;
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+               (force == NULL || strcmp(force, "avx2") == 0)) {
+        struct kernel s = { "avx2", 16, AVX2_NR, skernel_avx2 };
+        struct kernel d = { "avx2", 8, AVX2_NR, dkernel_avx2 };
+        sk = s;
+        dk = d;
+    }
+#endif
+
+    if (force != NULL && strcmp(force, dk.name) != 0)
+        printf("NATIVE_KERNEL=%s not supported, using %s\n", force, dk.name);
+
+    kernel_float = sk;
+    kernel_double = dk;
+}
+
+void native_set_blocking(enum precision prec, struct blocking blk)
+{
+    struct blocking *cur = (prec == PREC_FLOAT) ? &blocking_float : &blocking_double;
+
+    if (blk.mc > 0) cur->mc = blk.mc;
+    if (blk.kc > 0) cur->kc = blk.kc;
+    if (blk.nc > 0) cur->nc = blk.nc;
+}
+
+struct blocking native_get_blocking(enum precision prec)
+{
+    return (prec == PREC_FLOAT) ? blocking_float : blocking_double;
+}
+
+const char *native_kernel_name(void)
+{
+    pthread_once(&kernels_once, init_kernels);
+    return kernel_double.name;
+}
+
+/* ---------------------------------------------------------------------- */
+/* packing                                                                */
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Pack alpha * A(mc,kc) in panels of mr rows: for each column p the mr
+ * elements of the panel are contiguous. Rows past mc are zero.
+ */
+static void spack_a(int mc, int kc, int mr, float alpha, const float *A, int lda, float *ap)
+{
+    int i, ir, p;
+
+    for (ir = 0; ir < mc; ir += mr)
+        for (p = 0; p < kc; p++)
+            for (i = 0; i < mr; i++)
+                *ap++ = (ir + i < mc) ? alpha * A[ir + i + (size_t)p*lda] : 0.0f;
+}
+
+static void dpack_a(int mc, int kc, int mr, double alpha, const double *A, int lda, double *ap)
+{
+    int i, ir, p;
+
+    for (ir = 0; ir < mc; ir += mr)
+        for (p = 0; p < kc; p++)
+            for (i = 0; i < mr; i++)
+                *ap++ = (ir + i < mc) ? alpha * A[ir + i + (size_t)p*lda] : 0.0;
+}
+
+/*
+ * Pack the panel of nr columns of B(kc, nr) starting at column j: for each
+ * row p the nr elements are contiguous. Columns past nc are zero.
+ */
+static void spack_b(int kc, int nr, int nc, const float *B, int ldb, float *bp)
+{
+    int j, p;
+
+    for (p = 0; p < kc; p++)
+        for (j = 0; j < nr; j++)
+            *bp++ = (j < nc) ? B[p + (size_t)j*ldb] : 0.0f;
+}
+
+static void dpack_b(int kc, int nr, int nc, const double *B, int ldb, double *bp)
+{
+    int j, p;
+
+    for (p = 0; p < kc; p++)
+        for (j = 0; j < nr; j++)
+            *bp++ = (j < nc) ? B[p + (size_t)j*ldb] : 0.0;
+}
+
+/* ---------------------------------------------------------------------- */
+/* driver                                                                 */
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Round x up to a multiple of y.
+ */
+static size_t round_up(size_t x, size_t y)
+{
+    return (x + y - 1) / y * y;
+}
+
+/*
+ * Blocked GEMM on elements of the given precision (alpha and beta are
+ * converted when packing and scaling).
+ */
+static void native_gemm(enum precision prec, int m, int n, int k,
+                        double alpha, const void *A, int lda, const void *B, int ldb,
+                        double beta, void *C, int ldc)
+{
+    struct kernel ker;
+    struct blocking blk;
+    size_t size = precision_size(prec);
+    /* single threaded when called inside a parallel region (e.g. a batch) */
+    int nthreads = omp_in_parallel() ? 1 : omp_get_max_threads();
+    int mc, kc, nc, mr, nr, t, failed = 0;
+    void *bp, **aps;
+
+    if (m <= 0 || n <= 0)
+        return;
+
+    pthread_once(&kernels_once, init_kernels);
+    ker = (prec == PREC_FLOAT) ? kernel_float : kernel_double;
+    blk = native_get_blocking(prec);
+    mr = ker.mr;
+    nr = ker.nr;
+
+    /* enough MC blocks to keep all the threads busy on small or thin problems */
+    mc = min(round_up(blk.mc, mr), round_up((m + nthreads - 1) / nthreads, mr));
+    kc = min(blk.kc, k);
+    nc = min(round_up(blk.nc, nr), round_up(n, nr));
+
+    /* shared panel of B and one block of A per thread, allocated before the region */
+    bp = aligned_alloc(ALIGNMENT, round_up((size_t)kc * nc * size, ALIGNMENT));
+    aps = (void **)calloc(nthreads, sizeof(void *));
+    failed = (bp == NULL || aps == NULL);
+    for (t = 0; !failed && t < nthreads; t++)
+        failed = (aps[t] = aligned_alloc(ALIGNMENT, round_up((size_t)mc * kc * size, ALIGNMENT))) == NULL;
+    if (failed) {
+        printf("\n ERROR: native: can't allocate the packing buffers\n\n");
+        for (t = 0; aps != NULL && t < nthreads; t++)
+            free(aps[t]);
+        free(aps);
+        free(bp);
+        return;
+    }
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        void *ap = aps[omp_get_thread_num()];
+        char tile[MAX_TILE * sizeof(double)] __attribute__((aligned(ALIGNMENT)));
+        int i, j, jc, pc, ic, jr, ir, kb, nb, mb;
+
+        /* C = beta * C, the kernels accumulate on it */
+        #pragma omp for schedule(static)
+        for (j = 0; j < n; j++) {
+            if (prec == PREC_FLOAT) {
+                float *cj = (float *)C + (size_t)j*ldc;
+                for (i = 0; i < m; i++)
+                    cj[i] = (beta == 0.0) ? 0.0f : (float)beta * cj[i];
+            } else {
+                double *cj = (double *)C + (size_t)j*ldc;
+                for (i = 0; i < m; i++)
+                    cj[i] = (beta == 0.0) ? 0.0 : beta * cj[i];
+            }
+        }
+
+        for (jc = 0; jc < n; jc += nc) {
+            nb = min(nc, n - jc);
+            for (pc = 0; pc < k; pc += kc) {
+                kb = min(kc, k - pc);
+
+                /* the panels of B are shared: each thread packs some of them */
+                #pragma omp for schedule(static)
+                for (jr = 0; jr < nb; jr += nr) {
+                    size_t offset = (size_t)pc + (size_t)(jc + jr)*ldb;
+                    if (prec == PREC_FLOAT)
+                        spack_b(kb, nr, min(nr, nb - jr), (const float *)B + offset, ldb,
+                                (float *)bp + (size_t)jr*kb);
+                    else
+                        dpack_b(kb, nr, min(nr, nb - jr), (const double *)B + offset, ldb,
+                                (double *)bp + (size_t)jr*kb);
+                }
+
+                #pragma omp for schedule(dynamic)
+                for (ic = 0; ic < m; ic += mc) {
+                    mb = min(mc, m - ic);
+                    size_t offset = (size_t)ic + (size_t)pc*lda;
+                    if (prec == PREC_FLOAT)
+                        spack_a(mb, kb, mr, (float)alpha, (const float *)A + offset, lda, (float *)ap);
+                    else
+                        dpack_a(mb, kb, mr, alpha, (const double *)A + offset, lda, (double *)ap);
+
+                    for (jr = 0; jr < nb; jr += nr) {
+                        const char *b = (const char *)bp + (size_t)jr*kb*size;
+                        for (ir = 0; ir < mb; ir += mr) {
+                            const char *a = (const char *)ap + (size_t)ir*kb*size;
+                            char *c = (char *)C + ((size_t)(ic + ir) + (size_t)(jc + jr)*ldc) * size;
+                            int mt = min(mr, mb - ir), nt = min(nr, nb - jr);
+
+                            if (mt == mr && nt == nr) {
+                                ker.fn(kb, a, b, c, ldc);
+                            } else {
+                                /* partial tile: compute it apart and add the valid part */
+                                memset(tile, 0, (size_t)mr * nr * size);
+                                ker.fn(kb, a, b, tile, mr);
+                                for (j = 0; j < nt; j++)
+                                    for (i = 0; i < mt; i++) {
+                                        if (prec == PREC_FLOAT)
+                                            ((float *)c)[i + (size_t)j*ldc] += ((float *)tile)[i + j*mr];
+                                        else
+                                            ((double *)c)[i + (size_t)j*ldc] += ((double *)tile)[i + j*mr];
+                                    }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    for (t = 0; t < nthreads; t++)
+        free(aps[t]);
+    free(aps);
+    free(bp);
+}
+
+void native_sgemm(int layout, int transa, int transb, int m, int n, int k,
+                  float alpha, const float *A, int lda, const float *B, int ldb,
+                  float beta, float *C, int ldc)
+{
+    (void)layout; (void)transa; (void)transb;
+    native_gemm(PREC_FLOAT, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void native_dgemm(int layout, int transa, int transb, int m, int n, int k,
+                  double alpha, const double *A, int lda, const double *B, int ldb,
+                  double beta, double *C, int ldc)
+{
+    (void)layout; (void)transa; (void)transb;
+    native_gemm(PREC_DOUBLE, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
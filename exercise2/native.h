@@ -0,0 +1,49 @@
+/*
+ * In-tree GEMM in the GotoBLAS/BLIS style: the operands are packed in
+ * panels that fit the caches (MC x KC blocks of A, KC x NC blocks of B)
+ * and multiplied by register blocked FMA micro-kernels (AVX2 or AVX-512,
+ * chosen at run time, with a plain C fallback).
+ */
+
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include "backend.h"
+
+/*
+ * mc : rows of the packed block of A (L2)
+ * kc : depth of the packed blocks (L1 for a micro-panel of B)
+ * nc : columns of the packed block of B (L3)
+ */
+struct blocking
+{
+    int mc, kc, nc;
+};
+
+/*
+ * Set the blocking parameters of the given precision, a value <= 0 keeps the
+ * current one. mc is rounded up to a multiple of the micro-kernel rows.
+ */
+void native_set_blocking(enum precision prec, struct blocking blk);
+
+/*
+ * Returns the blocking parameters of the given precision.
+ */
+struct blocking native_get_blocking(enum precision prec);
+
+/*
+ * Returns the name of the micro-kernels in use (avx512, avx2, generic).
+ * They are chosen from the CPU features, NATIVE_KERNEL in the environment
+ * forces a (supported) one.
+ */
+const char *native_kernel_name(void);
+
+/* same signatures of cblas_sgemm/cblas_dgemm, only column major and non transposed operands */
+void native_sgemm(int layout, int transa, int transb, int m, int n, int k,
+                  float alpha, const float *A, int lda, const float *B, int ldb,
+                  float beta, float *C, int ldc);
+void native_dgemm(int layout, int transa, int transb, int m, int n, int k,
+                  double alpha, const double *A, int lda, const double *B, int ldb,
+                  double beta, double *C, int ldc);
+
+#endif
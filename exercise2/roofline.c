@@ -0,0 +1,393 @@
+/*
+ * Limits of the machine for the roofline of the GEMM results:
+ *  - sustained memory bandwidth, STREAM triad a = b + s * c, with all the
+ *    cores and with the cores of each NUMA node on its own memory;
+ *  - peak FMA throughput of float and double, with independent chains of
+ *    SIMD FMAs (AVX-512 or AVX2 chosen at run time) on all the cores.
+ *
+ * The results are written as "key value" lines, read by gemm.x -P:
+ *   bandwidth <GB/s>          all the cores
+ *   bandwidth_node<i> <GB/s>  cores and memory of node i
+ *   peak_float <GFLOP/s>
+ *   peak_double <GFLOP/s>
+ */
+
+#define _GNU_SOURCE
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include <omp.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define max(x,y) (((x) > (y)) ? (x) : (y))
+
+/* default elements of each triad array and repetitions (the best is kept) */
+#define ELEMENTS (1L << 25)
+#define REPS 10
+
+/* iterations of the FMA chains of each thread */
+#define FMA_ITERS 100000000L
+
+/* independent chains: enough to cover latency * pipes of the FMA units */
+#define CHAINS 12
+
+#define OUTPUT "roofline.dat"
+#define MAX_CPUS 4096
+
+/*
+ * Parse a list of ranges (e.g. 0-3,8-11) in an array.
+ * Returns the number of elements.
+ */
+int parse_list(char *list, int *items, int max_items)
+{
+    char *item, *save;
+    int first, last, i, count = 0;
+
+    for (item = strtok_r(list, ",\n", &save); item != NULL; item = strtok_r(NULL, ",\n", &save)) {
+        if (sscanf(item, "%d-%d", &first, &last) != 2) {
+            if (sscanf(item, "%d", &first) != 1)
+                continue;
+            last = first;
+        }
+        for (i = first; i <= last && count < max_items; i++)
+            items[count++] = i;
+    }
+    return count;
+}
+
+/*
+ * Read a list of ranges from a sysfs file.
+ * Returns the number of elements, 0 if the file can't be read.
+ */
+int read_list(const char *file, int *items, int max_items)
+{
+    char line[8192];
+    FILE *fp = fopen(file, "r");
+
+    if (fp == NULL)
+        return 0;
+    if (fgets(line, sizeof(line), fp) == NULL) {
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    return parse_list(line, items, max_items);
+}
+
+/*
+ * STREAM triad with the given threads, bound to the given cpus if not NULL.
+ * The arrays are first touched by the same threads, so with the cpus of a
+ * node they are on its memory.
+ *
+ * @return the best bandwidth in GB/s (3 arrays of doubles moved per iteration)
+ */
+double triad(long n, int reps, int threads, const int *cpus)
+{
+    double *a = (double *)malloc(n * sizeof(double));
+    double *b = (double *)malloc(n * sizeof(double));
+    double *c = (double *)malloc(n * sizeof(double));
+    double best = 0.0, s = 3.0;
+
+    if (a == NULL || b == NULL || c == NULL) {
+        printf("\n ERROR: Can't allocate the triad arrays\n\n");
+        free(a); free(b); free(c);
+        return 0.0;
+    }
+
+    #pragma omp parallel num_threads(threads)
+    {
+        cpu_set_t old, set;
+        long i;
+        int r;
+
+        if (cpus != NULL) {
+            sched_getaffinity(0, sizeof(old), &old);
+            CPU_ZERO(&set);
+            CPU_SET(cpus[omp_get_thread_num()], &set);
+            sched_setaffinity(0, sizeof(set), &set);
+        }
+
+        #pragma omp for schedule(static)
+        for (i = 0; i < n; i++) {
+            a[i] = 0.0;
+            b[i] = 1.0;
+            c[i] = 2.0;
+        }
+
+        for (r = 0; r < reps; r++) {
+            double start;
+
+            #pragma omp barrier
+            start = omp_get_wtime();
+            #pragma omp for schedule(static)
+            for (i = 0; i < n; i++)
+                a[i] = b[i] + s * c[i];
+            #pragma omp single
+            best = max(best, 3.0 * n * sizeof(double) / (omp_get_wtime() - start) * 1.0e-9);
+        }
+
+        if (cpus != NULL)
+            sched_setaffinity(0, sizeof(old), &old);
+    }
+
+    /* keep the stores */
+    if (a[n / 2] != 7.0)
+        printf("Warning: wrong triad result %lf\n", a[n / 2]);
+
+    free(a);
+    free(b);
+    free(c);
+    return best;
+}
+
+/* ---------------------------------------------------------------------- */
+/* FMA chains: each kernel returns the FLOPs done, sum is kept live       */
+/* ---------------------------------------------------------------------- */
+
+/* multiplier of the chains, not known at compile time so x * 1 + b is not simplified */
+volatile double one = 1.0;
+
+double speak_generic(long iters, double *sum)
+{
+    float x[CHAINS], a = (float)one, b = 1.0e-7f;
+    long it;
+    int j;
+
+    for (j = 0; j < CHAINS; j++)
+        x[j] = (float)j;
+    for (it = 0; it < iters; it++)
+        for (j = 0; j < CHAINS; j++)
+            x[j] = x[j] * a + b;
+    for (j = 0; j < CHAINS; j++)
+        *sum += x[j];
+    return 2.0 * iters * CHAINS;
+}
+
+double dpeak_generic(long iters, double *sum)
+{
+    double x[CHAINS], a = one, b = 1.0e-9;
+    long it;
+    int j;
+
+    for (j = 0; j < CHAINS; j++)
+        x[j] = (double)j;
+    for (it = 0; it < iters; it++)
+        for (j = 0; j < CHAINS; j++)
+            x[j] = x[j] * a + b;
+    for (j = 0; j < CHAINS; j++)
+        *sum += x[j];
+    return 2.0 * iters * CHAINS;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx2,fma")))
+double speak_avx2(long iters, double *sum)
+{
+    __m256 x[CHAINS], a = _mm256_set1_ps((float)one), b = _mm256_set1_ps(1.0e-7f);
+    float out[8];
+    long it;
+    int j, l;
+
+    #pragma GCC unroll 12
+    for (j = 0; j < CHAINS; j++)
+        x[j] = _mm256_set1_ps((float)j);
+    for (it = 0; it < iters; it++) {
+        #pragma GCC unroll 12
+        for (j = 0; j < CHAINS; j++)
+            x[j] = _mm256_fmadd_ps(x[j], a, b);
+    }
+    for (j = 0; j < CHAINS; j++) {
+        _mm256_storeu_ps(out, x[j]);
+        for (l = 0; l < 8; l++)
+            *sum += out[l];
+    }
+    return 2.0 * iters * CHAINS * 8;
+}
+
+__attribute__((target("avx2,fma")))
+double dpeak_avx2(long iters, double *sum)
+{
+    __m256d x[CHAINS], a = _mm256_set1_pd(one), b = _mm256_set1_pd(1.0e-9);
+    double out[4];
+    long it;
+    int j, l;
+
+    #pragma GCC unroll 12
+    for (j = 0; j < CHAINS; j++)
+        x[j] = _mm256_set1_pd((double)j);
+    for (it = 0; it < iters; it++) {
+        #pragma GCC unroll 12
+        for (j = 0; j < CHAINS; j++)
+            x[j] = _mm256_fmadd_pd(x[j], a, b);
+    }
+    for (j = 0; j < CHAINS; j++) {
+        _mm256_storeu_pd(out, x[j]);
+        for (l = 0; l < 4; l++)
+            *sum += out[l];
+    }
+    return 2.0 * iters * CHAINS * 4;
+}
+
+__attribute__((target("avx512f")))
+double speak_avx512(long iters, double *sum)
+{
+    __m512 x[CHAINS], a = _mm512_set1_ps((float)one), b = _mm512_set1_ps(1.0e-7f);
+    long it;
+    int j;
+
+    #pragma GCC unroll 12
+    for (j = 0; j < CHAINS; j++)
+        x[j] = _mm512_set1_ps((float)j);
+    for (it = 0; it < iters; it++) {
+        #pragma GCC unroll 12
+        for (j = 0; j < CHAINS; j++)
+            x[j] = _mm512_fmadd_ps(x[j], a, b);
+    }
+    for (j = 0; j < CHAINS; j++)
+        *sum += _mm512_reduce_add_ps(x[j]);
+    return 2.0 * iters * CHAINS * 16;
+}
+
+__attribute__((target("avx512f")))
+double dpeak_avx512(long iters, double *sum)
+{
+    __m512d x[CHAINS], a = _mm512_set1_pd(one), b = _mm512_set1_pd(1.0e-9);
+    long it;
+    int j;
+
+    #pragma GCC unroll 12
+    for (j = 0; j < CHAINS; j++)
+        x[j] = _mm512_set1_pd((double)j);
+    for (it = 0; it < iters; it++) {
+        #pragma GCC unroll 12
+        for (j = 0; j < CHAINS; j++)
+            x[j] = _mm512_fmadd_pd(x[j], a, b);
+    }
+    for (j = 0; j < CHAINS; j++)
+        *sum += _mm512_reduce_add_pd(x[j]);
+    return 2.0 * iters * CHAINS * 8;
+}
+
+#endif
+
+/*
+ * Peak FMA throughput of all the threads with the widest SIMD available.
+ *
+ * @return the GFLOP/s
+ */
+double peak(int is_float, long iters, const char **isa)
+{
+    double (*kernel)(long, double *) = is_float ? speak_generic : dpeak_generic;
+    double flop = 0.0, sum = 0.0, start, elapsed;
+
+    *isa = "generic";
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        kernel = is_float ? speak_avx512 : dpeak_avx512;
+        *isa = "avx512";
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        kernel = is_float ? speak_avx2 : dpeak_avx2;
+        *isa = "avx2";
+    }
+#endif
+
+    /* spawn the threads before the timing */
+    #pragma omp parallel
+    kernel(1000, &sum);
+
+    start = omp_get_wtime();
+    #pragma omp parallel reduction(+:flop, sum)
+    flop += kernel(iters, &sum);
+    elapsed = omp_get_wtime() - start;
+
+    if (sum == 0.0)
+        printf("Warning: unexpected FMA result\n");
+    return flop / elapsed * 1.0e-9;
+}
+
+void usage(char *name)
+{
+    printf("Usage: %s [-n elements] [-r reps] [-i iterations] [-o file]\n", name);
+    printf("  -n elements  elements of each triad array (default %ld)\n", ELEMENTS);
+    printf("  -r reps      repetitions of the triad, the best is kept (default %d)\n", REPS);
+    printf("  -i iters     iterations of the FMA chains of each thread (default %ld)\n", FMA_ITERS);
+    printf("  -o file      output file (default %s)\n", OUTPUT);
+}
+
+int main(int argc, char **argv)
+{
+    long n = ELEMENTS, iters = FMA_ITERS;
+    int reps = REPS, opt, node, ncpus, nnodes;
+    int nodes[MAX_CPUS], cpus[MAX_CPUS];
+    char *output = OUTPUT, path[256], host[256];
+    const char *isa;
+    double bw, pf, pd;
+    FILE *out;
+
+    while ((opt = getopt(argc, argv, "n:r:i:o:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            n = atol(optarg);
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'i':
+            iters = atol(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 0;
+        }
+    }
+    if (n < 1 || reps < 1 || iters < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    out = fopen(output, "w");
+    if (out == NULL) {
+        printf("\n ERROR: Can't open %s. Aborting... \n\n", output);
+        return 1;
+    }
+    if (gethostname(host, sizeof(host)) != 0)
+        strcpy(host, "unknown");
+    host[sizeof(host) - 1] = '\0';
+    fprintf(out, "# roofline of %s, %d threads\n", host, omp_get_max_threads());
+
+    bw = triad(n, reps, omp_get_max_threads(), NULL);
+    printf("triad, all cores: %lf GB/s\n", bw);
+    fprintf(out, "bandwidth %lf\n", bw);
+
+    nnodes = read_list("/sys/devices/system/node/online", nodes, MAX_CPUS);
+    for (node = 0; node < nnodes; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", nodes[node]);
+        ncpus = read_list(path, cpus, MAX_CPUS);
+        if (ncpus == 0)
+            continue;
+        bw = triad(n, reps, ncpus, cpus);
+        printf("triad, node %d (%d cores): %lf GB/s\n", nodes[node], ncpus, bw);
+        fprintf(out, "bandwidth_node%d %lf\n", nodes[node], bw);
+    }
+
+    pf = peak(1, iters, &isa);
+    printf("peak float (%s): %lf GFLOP/s\n", isa, pf);
+    fprintf(out, "peak_float %lf\n", pf);
+
+    pd = peak(0, iters, &isa);
+    printf("peak double (%s): %lf GFLOP/s\n", isa, pd);
+    fprintf(out, "peak_double %lf\n", pd);
+
+    fclose(out);
+    return 0;
+}
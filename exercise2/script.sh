@@ -14,22 +14,34 @@ module load architecture/AMD
 module load openBLAS/0.3.21-omp 
 module load mkl
 
-rm gemm_oblas.x
-rm gemm_mkl.x
+rm -f gemm.x roofline.x
 
 srun -n 1 make cpu
 
+# search threads, places/bind (and the blocking of native) once per node, the
+# best configurations are stored in gemm_tune.cache and used by the next runs
+# when OMP_NUM_THREADS, OMP_PLACES and OMP_PROC_BIND are not set
+# srun ./gemm.x -T -b oblas,mkl,native -p double -w 1 -r 5 -s 2000-20000:1000
+
 export OMP_NUM_THREADS=64
 export OMP_PLACES=cores
 export OMP_PROC_BIND=close
 
-for i in {2000..20000..1000}
-do
-    for j in {1..10}
-    do
-        srun ./gemm_oblas.x $i $i $i >> weak_scalability/double/cores_close_oblas.csv
-        srun ./gemm_mkl.x $i $i $i >> weak_scalability/double/cores_close_mkl.csv
-        echo
-    done
-    echo
-done
\ No newline at end of file
+# limits of the node (bandwidth and peak FMA) for the roofline of the results
+srun ./roofline.x -n 100000000 -o roofline.dat
+
+# the CSV of weak_scalability have only the type, size, time, gflop columns:
+# the harness writes its own files (it refuses to append under other columns)
+mkdir -p harness
+
+# one process per library sweeps all the sizes: 1 warm-up and 10 measured
+# repetitions for each size, summarized in a single CSV row, and the result
+# of the last one verified
+srun ./gemm.x -b oblas -p double -w 1 -r 10 -V -P roofline.dat -s 2000-20000:1000 -o harness/double_cores_close_oblas.csv
+srun ./gemm.x -b mkl -p double -w 1 -r 10 -V -P roofline.dat -s 2000-20000:1000 -o harness/double_cores_close_mkl.csv
+# the in-tree blocked GEMM as a baseline for the libraries
+srun ./gemm.x -b native -p double -w 1 -r 10 -V -P roofline.dat -s 2000-20000:1000 -o harness/double_cores_close_native.csv
+
+# accuracy and speed of the reduced precisions against dgemm
+srun ./gemm.x -b mkl -p bf16 -w 1 -r 10 -s 2000-20000:2000 -o bf16_mkl.csv
+srun ./gemm.x -b mkl -p refined -w 1 -r 10 -s 2000-20000:2000 -o refined_mkl.csv
@@ -0,0 +1,402 @@
+/*
+ * Distributed GEMM with the SUMMA algorithm.
+ *
+ * A(M,K), B(K,N) and C(M,N) are distributed on a Pr x Pc grid of processes
+ * with a 2D block-cyclic layout (square blocks of NB, column major local
+ * matrices, as ScaLAPACK). For each panel of NB columns of A / rows of B:
+ *  - the process column that owns the panel of A broadcasts it along the
+ *    process rows, the process row that owns the panel of B along the columns;
+ *  - every process adds the product of the two panels to its C.
+ * The broadcast of the next panels (MPI_Ibcast) is posted before the local
+ * multiplication of the current ones (double buffering). Most MPI libraries
+ * progress a nonblocking collective only inside MPI calls, so the local
+ * multiplication is split in column blocks of C with an MPI_Testall between
+ * them: the transfers advance while computing instead of in MPI_Waitall. The
+ * local multiplications use the backends of gemm.x (backend.c).
+ *
+ * The matrices are A(i,p) = a(i) w(p), B(p,j) = w(p) b(j), so every element
+ * of C(i,j) = a(i) b(j) sum(w(p)^2) is checked without communication.
+ */
+
+#include <math.h>
+#include <mpi.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "backend.h"
+
+#define min(x,y) (((x) < (y)) ? (x) : (y))
+
+#define NB 256
+#define SUB_BLOCKS 8
+#define WARMUP 1
+#define REPS 5
+#define BACKEND "oblas"
+
+#define CSV_HEADER "type, size, time, gflop, m, k, n, nb, grid_rows, grid_cols, rank, prow, pcol, compute, comm, wait, sub_blocks, error, backend\n"
+
+/*
+ * Number of rows (or columns) of a matrix of n rows with blocks of nb owned
+ * by the process iproc of nprocs (numroc of ScaLAPACK).
+ */
+int numroc(int n, int nb, int iproc, int nprocs)
+{
+    int blocks = n / nb;
+    int count = (blocks / nprocs) * nb;
+    int extra = blocks % nprocs;
+
+    if (iproc < extra)
+        count += nb;
+    else if (iproc == extra)
+        count += n % nb;
+    return count;
+}
+
+/*
+ * Global index of the local index l of the process iproc of nprocs.
+ */
+int global_index(int l, int nb, int iproc, int nprocs)
+{
+    return ((l / nb) * nprocs + iproc) * nb + l % nb;
+}
+
+/* factors of the matrices, see the header */
+double fa(int i) { return 1.0 + (i % 13) / 13.0; }
+double fb(int j) { return 1.0 + (j % 7) / 7.0; }
+double fw(int p) { return 1.0 + (p % 5) / 5.0; }
+
+/*
+ * Set an element of a local matrix of the given precision.
+ */
+void set_element(enum precision prec, void *X, size_t i, double value)
+{
+    if (prec == PREC_FLOAT)
+        ((float *)X)[i] = (float)value;
+    else
+        ((double *)X)[i] = value;
+}
+
+double get_element(enum precision prec, const void *X, size_t i)
+{
+    return (prec == PREC_FLOAT) ? (double)((const float *)X)[i] : ((const double *)X)[i];
+}
+
+/*
+ * Local part of a distributed matrix.
+ * rows, cols : local size (ld = rows)
+ * data       : elements, column major
+ */
+struct local
+{
+    int rows, cols;
+    void *data;
+};
+
+/*
+ * State of the SUMMA of a process: grid, communicators, panel buffers and
+ * number of column blocks of the local multiplication (MPI_Testall between them).
+ */
+struct summa
+{
+    int prow, pcol, grid_rows, grid_cols;
+    int sub;
+    MPI_Comm row_comm, col_comm;
+    void *apanel[2], *bpanel[2];
+    MPI_Request requests[2][2];
+};
+
+/*
+ * Copy the panel t of A and B in the buffers of the owners and post the
+ * broadcasts (A along the process row, B along the process column).
+ */
+void post_panel(struct summa *sm, enum precision prec, MPI_Datatype type, int t, int nb, int k,
+                const struct local *A, const struct local *B, int slot)
+{
+    size_t size = precision_size(prec);
+    int kw = min(nb, k - t * nb);
+    int owner_col = t % sm->grid_cols, owner_row = t % sm->grid_rows;
+    int j;
+
+    /* the columns of the panel of A are contiguous in the local A */
+    if (sm->pcol == owner_col)
+        memcpy(sm->apanel[slot], (char *)A->data + (size_t)(t / sm->grid_cols) * nb * A->rows * size,
+               (size_t)A->rows * kw * size);
+
+    /* the rows of the panel of B are packed in a kw x cols matrix, kw contiguous elements per column */
+    if (sm->prow == owner_row) {
+        int offset = (t / sm->grid_rows) * nb;
+        for (j = 0; j < B->cols; j++)
+            memcpy((char *)sm->bpanel[slot] + (size_t)j * kw * size,
+                   (char *)B->data + ((size_t)offset + (size_t)j * B->rows) * size, (size_t)kw * size);
+    }
+
+    MPI_Ibcast(sm->apanel[slot], A->rows * kw, type, owner_col, sm->row_comm, &sm->requests[slot][0]);
+    MPI_Ibcast(sm->bpanel[slot], kw * B->cols, type, owner_row, sm->col_comm, &sm->requests[slot][1]);
+}
+
+/*
+ * C = A * B with SUMMA, the times spent in the local multiplications and in
+ * the communication (copies, posting, polling and waiting) are added to compute
+ * and comm, the time blocked in MPI_Waitall (the transfer not overlapped) to wait.
+ */
+void summa_gemm(struct summa *sm, struct backend *b, enum precision prec, int k, int nb,
+                const struct local *A, const struct local *B, struct local *C,
+                double *compute, double *comm, double *wait)
+{
+    MPI_Datatype type = (prec == PREC_FLOAT) ? MPI_FLOAT : MPI_DOUBLE;
+    size_t size = precision_size(prec);
+    int panels = (k + nb - 1) / nb, width = (C->cols + sm->sub - 1) / sm->sub, t, jb, done;
+    double start, blocked;
+
+    memset(C->data, 0, (size_t)C->rows * C->cols * precision_size(prec));
+
+    start = MPI_Wtime();
+    post_panel(sm, prec, type, 0, nb, k, A, B, 0);
+    *comm += MPI_Wtime() - start;
+
+    for (t = 0; t < panels; t++) {
+        int slot = t % 2, kw = min(nb, k - t * nb);
+
+        /* the next panels travel while the current ones are multiplied */
+        start = MPI_Wtime();
+        if (t + 1 < panels)
+            post_panel(sm, prec, type, t + 1, nb, k, A, B, 1 - slot);
+        blocked = MPI_Wtime();
+        MPI_Waitall(2, sm->requests[slot], MPI_STATUSES_IGNORE);
+        *wait += MPI_Wtime() - blocked;
+        *comm += MPI_Wtime() - start;
+
+        /* column blocks of C (the whole depth kw of the panel), the library
+           progresses the next broadcasts in the MPI_Testall between them */
+        done = (t + 1 == panels);
+        for (jb = 0; C->rows > 0 && jb < C->cols; jb += width) {
+            start = MPI_Wtime();
+            backend_gemm(b, prec, C->rows, min(width, C->cols - jb), kw, 1.0, sm->apanel[slot], C->rows,
+                         (char *)sm->bpanel[slot] + (size_t)jb * kw * size, kw, 1.0,
+                         (char *)C->data + (size_t)jb * C->rows * size, C->rows);
+            *compute += MPI_Wtime() - start;
+
+            if (!done) {
+                start = MPI_Wtime();
+                MPI_Testall(2, sm->requests[1 - slot], &done, MPI_STATUSES_IGNORE);
+                *comm += MPI_Wtime() - start;
+            }
+        }
+    }
+}
+
+void usage(char *name)
+{
+    printf("Usage: %s [-b backend] [-p precision] [-n nb] [-g RxC] [-w warmup] [-r reps] [-o file.csv] M K N\n", name);
+    printf("  -b name     backend of the local multiplications name[=library] (default %s)\n", BACKEND);
+    printf("  -p prec     float or double (default double)\n");
+    printf("  -n nb       size of the blocks of the block-cyclic layout (default %d)\n", NB);
+    printf("  -s sub      column blocks of the local multiplication, polled in between (default %d)\n", SUB_BLOCKS);
+    printf("  -g RxC      process grid (default from MPI_Dims_create)\n");
+    printf("  -w warmup   untimed repetitions (default %d)\n", WARMUP);
+    printf("  -r reps     measured repetitions, the median is reported (default %d)\n", REPS);
+    printf("  -o file     append the results to a CSV file (default standard output)\n");
+}
+
+int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    int rank, size, provided, opt, m, k, n, nb = NB, sub = SUB_BLOCKS, warmup = WARMUP, reps = REPS, r, i, j, p;
+    int dims[2] = { 0, 0 }, periods[2] = { 0, 0 }, coords[2], remain[2];
+    char *backend_name = BACKEND, *path, *output = NULL;
+    enum precision prec = PREC_DOUBLE;
+    struct backend b;
+    struct summa sm;
+    struct local A, B, C;
+    MPI_Comm grid;
+    size_t esize;
+    double *times, compute = 0.0, comm = 0.0, wait = 0.0, wsum = 0.0, error = 0.0, elapsed, start;
+    FILE *out = stdout;
+
+    /* only the main thread calls MPI, the backends run OpenMP threads */
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (rank == 0 && provided < MPI_THREAD_FUNNELED)
+        printf("Warning: the MPI library does not support MPI_THREAD_FUNNELED\n");
+
+    while ((opt = getopt(argc, argv, "b:p:n:s:g:w:r:o:h")) != -1) {
+        switch (opt) {
+        case 'b':
+            backend_name = optarg;
+            break;
+        case 'p':
+            prec = (strcmp(optarg, "float") == 0) ? PREC_FLOAT : PREC_DOUBLE;
+            break;
+        case 'n':
+            nb = atoi(optarg);
+            break;
+        case 's':
+            sub = atoi(optarg);
+            break;
+        case 'g':
+            if (sscanf(optarg, "%dx%d", &dims[0], &dims[1]) != 2)
+                dims[0] = dims[1] = 0;
+            break;
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            if (rank == 0)
+                usage(argv[0]);
+            MPI_Finalize();
+            return 0;
+        }
+    }
+    if (argc - optind != 3 || nb < 1 || sub < 1 || reps < 1 || warmup < 0 ||
+        (dims[0] * dims[1] != 0 && dims[0] * dims[1] != size)) {
+        if (rank == 0)
+            usage(argv[0]);
+        MPI_Finalize();
+        return 1;
+    }
+    m = atoi(argv[optind]);
+    k = atoi(argv[optind + 1]);
+    n = atoi(argv[optind + 2]);
+
+    path = strchr(backend_name, '=');
+    if (path != NULL)
+        *path++ = '\0';
+    if (backend_load(&b, backend_name, path) != 0)
+        MPI_Abort(MPI_COMM_WORLD, 1);
+
+    /* 2D grid, row and column communicators */
+    MPI_Dims_create(size, 2, dims);
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &grid);
+    MPI_Cart_coords(grid, rank, 2, coords);
+    memset(&sm, 0, sizeof(sm));
+    sm.sub = sub;
+    sm.grid_rows = dims[0];
+    sm.grid_cols = dims[1];
+    sm.prow = coords[0];
+    sm.pcol = coords[1];
+    remain[0] = 0; remain[1] = 1;
+    MPI_Cart_sub(grid, remain, &sm.row_comm);
+    remain[0] = 1; remain[1] = 0;
+    MPI_Cart_sub(grid, remain, &sm.col_comm);
+
+    /* local parts */
+    esize = precision_size(prec);
+    A.rows = numroc(m, nb, sm.prow, sm.grid_rows);
+    A.cols = numroc(k, nb, sm.pcol, sm.grid_cols);
+    B.rows = numroc(k, nb, sm.prow, sm.grid_rows);
+    B.cols = numroc(n, nb, sm.pcol, sm.grid_cols);
+    C.rows = A.rows;
+    C.cols = B.cols;
+    A.data = malloc((size_t)A.rows * A.cols * esize + 1);
+    B.data = malloc((size_t)B.rows * B.cols * esize + 1);
+    C.data = malloc((size_t)C.rows * C.cols * esize + 1);
+    for (i = 0; i < 2; i++) {
+        sm.apanel[i] = malloc((size_t)A.rows * nb * esize + 1);
+        sm.bpanel[i] = malloc((size_t)nb * B.cols * esize + 1);
+    }
+    times = (double *)malloc(reps * sizeof(double));
+
+    #pragma omp parallel for private(i)
+    for (j = 0; j < A.cols; j++)
+        for (i = 0; i < A.rows; i++)
+            set_element(prec, A.data, i + (size_t)j * A.rows,
+                        fa(global_index(i, nb, sm.prow, sm.grid_rows)) * fw(global_index(j, nb, sm.pcol, sm.grid_cols)));
+    #pragma omp parallel for private(i)
+    for (j = 0; j < B.cols; j++)
+        for (i = 0; i < B.rows; i++)
+            set_element(prec, B.data, i + (size_t)j * B.rows,
+                        fw(global_index(i, nb, sm.prow, sm.grid_rows)) * fb(global_index(j, nb, sm.pcol, sm.grid_cols)));
+
+    for (r = 0; r < warmup; r++) {
+        double unused = 0.0;
+        summa_gemm(&sm, &b, prec, k, nb, &A, &B, &C, &unused, &unused, &unused);
+    }
+
+    /* time of a repetition: the slowest process */
+    for (r = 0; r < reps; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        start = MPI_Wtime();
+        summa_gemm(&sm, &b, prec, k, nb, &A, &B, &C, &compute, &comm, &wait);
+        elapsed = MPI_Wtime() - start;
+        MPI_Allreduce(&elapsed, &times[r], 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    }
+    compute /= reps;
+    comm /= reps;
+    wait /= reps;
+
+    /* check C(i,j) = a(i) b(j) sum(w(p)^2) */
+    for (p = 0; p < k; p++)
+        wsum += fw(p) * fw(p);
+    for (j = 0; j < C.cols; j++)
+        for (i = 0; i < C.rows; i++) {
+            double expected = fa(global_index(i, nb, sm.prow, sm.grid_rows)) *
+                              fb(global_index(j, nb, sm.pcol, sm.grid_cols)) * wsum;
+            double err = fabs(get_element(prec, C.data, i + (size_t)j * C.rows) - expected) / expected;
+            if (err > error)
+                error = err;
+        }
+    MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    /* per process times on rank 0 */
+    {
+        double mine[5] = { compute, comm, wait, (double)sm.prow, (double)sm.pcol };
+        double *all = (rank == 0) ? (double *)malloc(5 * size * sizeof(double)) : NULL;
+
+        MPI_Gather(mine, 5, MPI_DOUBLE, all, 5, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            double median, gflops;
+
+            qsort(times, reps, sizeof(double), compare_double);
+            median = (reps % 2) ? times[reps / 2] : 0.5 * (times[reps / 2 - 1] + times[reps / 2]);
+            gflops = 2.0 * m * n * k / median * 1.0e-9;
+
+            if (output != NULL) {
+                out = fopen(output, "a");
+                if (out == NULL) {
+                    printf("\n ERROR: Can't open %s. Aborting... \n\n", output);
+                    MPI_Abort(MPI_COMM_WORLD, 1);
+                }
+            }
+            if (out == stdout || ftell(out) == 0)
+                fprintf(out, CSV_HEADER);
+            for (i = 0; i < size; i++)
+                fprintf(out, "%s, %d, %lf, %lf, %d, %d, %d, %d, %d, %d, %d, %d, %d, %lf, %lf, %lf, %d, %e, %s\n",
+                        precision_name(prec), m, median, gflops, m, k, n, nb, sm.grid_rows, sm.grid_cols,
+                        i, (int)all[5 * i + 3], (int)all[5 * i + 4], all[5 * i], all[5 * i + 1], all[5 * i + 2],
+                        sub, error, b.name);
+            if (out != stdout)
+                fclose(out);
+            free(all);
+        }
+    }
+
+    free(A.data);
+    free(B.data);
+    free(C.data);
+    for (i = 0; i < 2; i++) {
+        free(sm.apanel[i]);
+        free(sm.bpanel[i]);
+    }
+    free(times);
+    backend_close(&b);
+    MPI_Comm_free(&sm.row_comm);
+    MPI_Comm_free(&sm.col_comm);
+    MPI_Comm_free(&grid);
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,44 @@
+#!/bin/bash
+
+#SBATCH --job-name="summa"
+#SBATCH --output=summa.out
+#SBATCH --partition=EPYC
+#SBATCH --nodes=4
+#SBATCH --exclusive
+#SBATCH --ntasks-per-node=2
+#SBATCH --cpus-per-task=64
+#SBATCH --time=02:00:00
+
+module load architecture/AMD
+module load openBLAS/0.3.21-omp
+module load openMPI/4.1.5/gnu
+
+rm -f summa.x
+
+srun -n 1 make mpi
+
+# one process per socket, the local multiplications use the threads of the socket
+export OMP_NUM_THREADS=64
+export OMP_PLACES=cores
+export OMP_PROC_BIND=close
+
+# strong scalability: fixed size on 1, 2, 4 and 8 processes (1 to 4 nodes)
+for np in 1 2 4 8; do
+    mpirun -np $np --map-by socket --bind-to socket ./summa.x -b oblas -p double -n 512 -r 5 \
+        -o strong_scalability/summa_double_oblas.csv 20000 20000 20000
+done
+
+# weak scalability: the work per process is the one of a 10000^3 multiplication
+for np in 1 2 4 8; do
+    size=$(echo "10000 * e(l($np) / 3)" | bc -l | cut -d. -f1)
+    mpirun -np $np --map-by socket --bind-to socket ./summa.x -b oblas -p double -n 512 -r 5 \
+        -o weak_scalability/summa_double_oblas.csv $size $size $size
+done
+
+# overlap: the local multiplication in one block (no polling, the broadcasts progress only in
+# MPI_Waitall) against the default column blocks with MPI_Testall in between, compare the wait column
+mkdir -p overlap
+for sub in 1 8; do
+    mpirun -np 8 --map-by socket --bind-to socket ./summa.x -b oblas -p double -n 512 -r 5 -s $sub \
+        -o overlap/summa_double_oblas.csv 20000 20000 20000
+done
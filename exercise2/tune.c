@@ -0,0 +1,270 @@
+/*
+ * Autotuning of the GEMM benchmark and cache of the best configurations.
+ *
+ * Each line of the cache is
+ *   host backend precision m k n threads places bind mc kc nc gflops
+ */
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "tune.h"
+
+#define MAX_LINE 512
+
+static const char *places_list[] = { "cores", "sockets", "threads" };
+static const char *bind_list[] = { "close", "spread", "master" };
+static const int mc_list[] = { 48, 72, 96, 144, 192, 288, 384 };
+static const int kc_list[] = { 128, 192, 256, 384, 512, 768 };
+static const int nc_list[] = { 1020, 2040, 4080, 8160, 16320 };
+
+#define LEN(x) ((int)(sizeof(x) / sizeof((x)[0])))
+
+/*
+ * Get the hostname, the key of the machine in the cache.
+ */
+static void get_host(char *host, size_t len)
+{
+    if (gethostname(host, len) != 0)
+        strncpy(host, "unknown", len);
+    host[len - 1] = '\0';
+}
+
+int tune_lookup(const char *file, const char *backend, enum precision prec,
+                int m, int k, int n, struct tune_config *cfg)
+{
+    char line[MAX_LINE], host[256], h[256], b[64], p[16];
+    int lm, lk, ln, found = 0;
+    struct tune_config c;
+    FILE *fp;
+
+    if (file == NULL || strcmp(file, "none") == 0 || (fp = fopen(file, "r")) == NULL)
+        return 0;
+
+    get_host(host, sizeof(host));
+    while (fgets(line, MAX_LINE, fp) != NULL) {
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "%255s %63s %15s %d %d %d %d %15s %15s %d %d %d %lf", h, b, p, &lm, &lk, &ln,
+                   &c.threads, c.places, c.bind, &c.blk.mc, &c.blk.kc, &c.blk.nc, &c.gflops) != 13)
+            continue;
+        if (strcmp(h, host) == 0 && strcmp(b, backend) == 0 && strcmp(p, precision_name(prec)) == 0 &&
+            lm == m && lk == k && ln == n) {
+            *cfg = c;
+            found = 1;
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+void tune_store(const char *file, const char *backend, enum precision prec,
+                int m, int k, int n, const struct tune_config *cfg)
+{
+    char line[MAX_LINE], host[256], h[256], b[64], p[16];
+    char **lines = NULL;
+    int count = 0, lm, lk, ln, i;
+    FILE *fp;
+
+    if (file == NULL || strcmp(file, "none") == 0)
+        return;
+
+    get_host(host, sizeof(host));
+
+    /* keep the other entries */
+    if ((fp = fopen(file, "r")) != NULL) {
+        while (fgets(line, MAX_LINE, fp) != NULL) {
+            if (sscanf(line, "%255s %63s %15s %d %d %d", h, b, p, &lm, &lk, &ln) == 6 &&
+                strcmp(h, host) == 0 && strcmp(b, backend) == 0 && strcmp(p, precision_name(prec)) == 0 &&
+                lm == m && lk == k && ln == n)
+                continue;
+            lines = (char **)realloc(lines, (count + 1) * sizeof(char *));
+            lines[count++] = strdup(line);
+        }
+        fclose(fp);
+    }
+
+    if ((fp = fopen(file, "w")) == NULL) {
+        printf("\n ERROR: Can't write the tuning cache %s\n\n", file);
+    } else {
+        if (count == 0)
+            fprintf(fp, "# host backend precision m k n threads places bind mc kc nc gflops\n");
+        for (i = 0; i < count; i++)
+            fputs(lines[i], fp);
+        fprintf(fp, "%s %s %s %d %d %d %d %s %s %d %d %d %lf\n", host, backend, precision_name(prec),
+                m, k, n, cfg->threads, cfg->places, cfg->bind, cfg->blk.mc, cfg->blk.kc, cfg->blk.nc, cfg->gflops);
+        fclose(fp);
+    }
+
+    for (i = 0; i < count; i++)
+        free(lines[i]);
+    free(lines);
+}
+
+/*
+ * Measure a configuration in a new process of the benchmark with the
+ * OpenMP environment of the configuration.
+ *
+ * @return the GFLOP/s of the median time, a negative value on failure
+ */
+static double measure_config(const char *self, const struct backend *b, enum precision prec,
+                             int m, int k, int n, int warmup, int reps, const struct tune_config *cfg)
+{
+    char spec[1024], shape[64], w[16], r[16], blk[64], threads[16];
+    char output[MAX_LINE] = "";
+    char *args[20];
+    int fd[2], status, na = 0;
+    double time, gflops = -1.0;
+    ssize_t len, total = 0;
+    pid_t pid;
+
+    /* the child loads the same library: name=path (owned by the backend) */
+    if (b->path != NULL)
+        len = snprintf(spec, sizeof(spec), "%s=%s", b->name, b->path);
+    else
+        len = snprintf(spec, sizeof(spec), "%s", b->name);
+    if (len < 0 || (size_t)len >= sizeof(spec)) {
+        printf("\n ERROR: library path of backend %s too long for the autotuning\n\n", b->name);
+        return -1.0;
+    }
+    snprintf(shape, sizeof(shape), "%dx%dx%d", m, k, n);
+    snprintf(w, sizeof(w), "%d", warmup);
+    snprintf(r, sizeof(r), "%d", reps);
+    snprintf(threads, sizeof(threads), "%d", cfg->threads);
+
+    args[na++] = (char *)self;
+    args[na++] = "-b"; args[na++] = spec;
+    args[na++] = "-p"; args[na++] = (char *)precision_name(prec);
+    args[na++] = "-w"; args[na++] = w;
+    args[na++] = "-r"; args[na++] = r;
+    args[na++] = "-C"; args[na++] = "none";
+    if (cfg->blk.mc > 0) {
+        snprintf(blk, sizeof(blk), "%d,%d,%d", cfg->blk.mc, cfg->blk.kc, cfg->blk.nc);
+        args[na++] = "-B"; args[na++] = blk;
+    }
+    args[na++] = "-s"; args[na++] = shape;
+    args[na] = NULL;
+
+    if (pipe(fd) != 0)
+        return -1.0;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        close(fd[0]);
+        close(fd[1]);
+        return -1.0;
+    }
+    if (pid == 0) {
+        dup2(fd[1], STDOUT_FILENO);
+        close(fd[0]);
+        close(fd[1]);
+        setenv("OMP_NUM_THREADS", threads, 1);
+        setenv("OMP_PLACES", cfg->places, 1);
+        setenv("OMP_PROC_BIND", cfg->bind, 1);
+        execv(self, args);
+        _exit(127);
+    }
+
+    close(fd[1]);
+    while ((len = read(fd[0], output + total, sizeof(output) - 1 - total)) > 0)
+        total += len;
+    output[total] = '\0';
+    close(fd[0]);
+    waitpid(pid, &status, 0);
+
+    /* the child writes a single CSV row: type, size, time, ... */
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+        sscanf(output, "%*[^,], %*d, %lf", &time) == 1 && time > 0.0)
+        gflops = 2.0 * m * n * k / time * 1.0e-9;
+
+    printf("tune: %s %s %dx%dx%d threads %d places %s bind %s", b->name, precision_name(prec),
+           m, k, n, cfg->threads, cfg->places, cfg->bind);
+    if (cfg->blk.mc > 0)
+        printf(" blocking %d,%d,%d", cfg->blk.mc, cfg->blk.kc, cfg->blk.nc);
+    if (gflops > 0.0)
+        printf(" -> %lf GFLOP/s\n", gflops);
+    else
+        printf(" -> failed\n");
+    fflush(stdout);
+
+    return gflops;
+}
+
+/*
+ * Measure the candidate and keep it if it is better than the best one.
+ */
+static void try_config(const char *self, const struct backend *b, enum precision prec,
+                       int m, int k, int n, int warmup, int reps,
+                       struct tune_config *cand, struct tune_config *best)
+{
+    cand->gflops = measure_config(self, b, prec, m, k, n, warmup, reps, cand);
+    if (cand->gflops > best->gflops)
+        *best = *cand;
+}
+
+int autotune(const char *self, const struct backend *b, enum precision prec,
+             int m, int k, int n, int warmup, int reps, struct tune_config *best)
+{
+    struct tune_config cand;
+    int procs = omp_get_num_procs();
+    int t, i, j;
+
+    memset(best, 0, sizeof(*best));
+    best->gflops = -1.0;
+
+    memset(&cand, 0, sizeof(cand));
+    strcpy(cand.places, places_list[0]);
+    strcpy(cand.bind, bind_list[0]);
+    if (strcmp(b->name, "native") == 0)
+        cand.blk = native_get_blocking(prec);
+
+    /* thread count: powers of two and all the cores */
+    for (t = 1; ; t = (t * 2 < procs) ? t * 2 : procs) {
+        cand.threads = t;
+        try_config(self, b, prec, m, k, n, warmup, reps, &cand, best);
+        if (t == procs)
+            break;
+    }
+    if (best->gflops <= 0.0)
+        return -1;
+
+    /* places and bind with the best thread count */
+    for (i = 0; i < LEN(places_list); i++)
+        for (j = 0; j < LEN(bind_list); j++) {
+            if (i == 0 && j == 0)
+                continue;
+            cand = *best;
+            strcpy(cand.places, places_list[i]);
+            strcpy(cand.bind, bind_list[j]);
+            try_config(self, b, prec, m, k, n, warmup, reps, &cand, best);
+        }
+
+    /* blocking of the native backend, one parameter at a time */
+    if (strcmp(b->name, "native") == 0) {
+        for (i = 0; i < LEN(mc_list); i++) {
+            cand = *best;
+            cand.blk.mc = mc_list[i];
+            if (cand.blk.mc != best->blk.mc)
+                try_config(self, b, prec, m, k, n, warmup, reps, &cand, best);
+        }
+        for (i = 0; i < LEN(kc_list); i++) {
+            cand = *best;
+            cand.blk.kc = kc_list[i];
+            if (cand.blk.kc != best->blk.kc)
+                try_config(self, b, prec, m, k, n, warmup, reps, &cand, best);
+        }
+        for (i = 0; i < LEN(nc_list); i++) {
+            cand = *best;
+            cand.blk.nc = nc_list[i];
+            if (cand.blk.nc != best->blk.nc)
+                try_config(self, b, prec, m, k, n, warmup, reps, &cand, best);
+        }
+    }
+
+    return 0;
+}
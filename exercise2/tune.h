@@ -0,0 +1,57 @@
+/*
+ * Autotuning of the thread count, the OpenMP places/bind policy and the
+ * blocking of the native backend, with a cache of the best configuration
+ * of each machine, backend, precision and shape.
+ */
+
+#ifndef TUNE_H
+#define TUNE_H
+
+#include "backend.h"
+#include "native.h"
+
+/* default cache file, "none" disables the cache */
+#define TUNE_CACHE "gemm_tune.cache"
+
+/*
+ * threads : number of OpenMP threads
+ * places  : OMP_PLACES (cores, sockets, threads)
+ * bind    : OMP_PROC_BIND (close, spread, master)
+ * blk     : blocking of the native backend (zero for the other backends)
+ * gflops  : performance of the configuration (median time)
+ */
+struct tune_config
+{
+    int threads;
+    char places[16];
+    char bind[16];
+    struct blocking blk;
+    double gflops;
+};
+
+/*
+ * Look for the configuration of this machine (hostname) for the given backend,
+ * precision and shape in the cache file. Returns 1 if found, 0 otherwise.
+ */
+int tune_lookup(const char *file, const char *backend, enum precision prec,
+                int m, int k, int n, struct tune_config *cfg);
+
+/*
+ * Store (or replace) the configuration of this machine for the given backend,
+ * precision and shape in the cache file.
+ */
+void tune_store(const char *file, const char *backend, enum precision prec,
+                int m, int k, int n, const struct tune_config *cfg);
+
+/*
+ * Search the best configuration of a backend for the given shape. Every
+ * candidate is measured by a new process of the benchmark (self), since the
+ * places and the binding of the threads are fixed when OpenMP starts:
+ * first the thread count (cores, close), then places and bind, then (native
+ * backend only) MC, KC and NC one at a time.
+ * Returns 0 on success, -1 if no candidate could be measured.
+ */
+int autotune(const char *self, const struct backend *b, enum precision prec,
+             int m, int k, int n, int warmup, int reps, struct tune_config *best);
+
+#endif
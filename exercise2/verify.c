@@ -0,0 +1,85 @@
+/*
+ * Freivalds' check of a GEMM.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "verify.h"
+
+#define min(x,y) (((x) < (y)) ? (x) : (y))
+
+/*
+ * y = X x and ya = |X| xa for the column major X(rows,cols), blocks of rows in
+ * parallel (each thread reads its rows of all the columns, contiguously).
+ */
+static void matvec(enum precision prec, const void *X, int rows, int cols,
+                   const long double *x, const long double *xa, long double *y, long double *ya)
+{
+    int ib;
+
+    #pragma omp parallel for schedule(static)
+    for (ib = 0; ib < rows; ib += VERIFY_BLOCK) {
+        int i, j, ie = min(ib + VERIFY_BLOCK, rows);
+
+        for (i = ib; i < ie; i++)
+            y[i] = ya[i] = 0.0L;
+        for (j = 0; j < cols; j++) {
+            if (prec == PREC_FLOAT) {
+                const float *col = (const float *)X + (size_t)j * rows;
+                for (i = ib; i < ie; i++) {
+                    y[i] += col[i] * x[j];
+                    ya[i] += fabsl(col[i]) * xa[j];
+                }
+            } else {
+                const double *col = (const double *)X + (size_t)j * rows;
+                for (i = ib; i < ie; i++) {
+                    y[i] += col[i] * x[j];
+                    ya[i] += fabsl(col[i]) * xa[j];
+                }
+            }
+        }
+    }
+}
+
+double verify_gemm(enum precision prec, int m, int n, int k, const void *A, const void *B,
+                   const void *C, unsigned long seed)
+{
+    long double *x = (long double *)malloc(n * sizeof(long double));
+    long double *y = (long double *)malloc(k * sizeof(long double));
+    long double *ya = (long double *)malloc(k * sizeof(long double));
+    long double *z = (long double *)malloc(m * sizeof(long double));
+    long double *za = (long double *)malloc(m * sizeof(long double));
+    long double *w = (long double *)malloc(m * sizeof(long double));
+    long double *wa = (long double *)malloc(m * sizeof(long double));
+    double res = 0.0;
+    int i;
+
+    if (x == NULL || y == NULL || ya == NULL || z == NULL || za == NULL || w == NULL || wa == NULL) {
+        res = -1.0;
+    } else {
+        srand48((long)seed);
+        for (i = 0; i < n; i++)
+            x[i] = 0.5L + 0.5L * drand48();
+
+        /* y = B x, z = A y, za = |A| |B| x, w = C x */
+        matvec(prec, B, k, n, x, x, y, ya);
+        matvec(prec, A, m, k, y, ya, z, za);
+        matvec(prec, C, m, n, x, x, w, wa);
+
+        #pragma omp parallel for reduction(max:res)
+        for (i = 0; i < m; i++) {
+            long double r = fabsl(w[i] - z[i]);
+            res = fmax(res, (double)((za[i] > 0.0L) ? r / za[i] : r));
+        }
+    }
+
+    free(x);
+    free(y);
+    free(ya);
+    free(z);
+    free(za);
+    free(w);
+    free(wa);
+    return res;
+}
@@ -0,0 +1,25 @@
+/*
+ * Verification of C = A * B with Freivalds' check: for a random x the
+ * residual C x - A (B x) is computed in long double with three parallel
+ * matrix-vector products (O(mk + kn + mn) instead of O(mnk)) and compared,
+ * row by row, with (|A| (|B| x)), the scale of the rounding errors of GEMM.
+ */
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include "backend.h"
+
+/* rows (or columns) of a block of the parallel matrix-vector products */
+#define VERIFY_BLOCK 256
+
+/*
+ * Returns the largest residual |C x - A (B x)|_i / (|A| (|B| x))_i of the
+ * column major A(m,k) B(k,n) C(m,n) of the given precision, with x random
+ * (from seed) in [0.5,1). A correct GEMM gives at most k times the unit
+ * roundoff of the precision. Returns -1 if the memory can't be allocated.
+ */
+double verify_gemm(enum precision prec, int m, int n, int k, const void *A, const void *B,
+                   const void *C, unsigned long seed);
+
+#endif